@@ -0,0 +1,289 @@
+#pragma once
+
+#include "GL/gl.hpp"
+#include "GL/frustum.hpp"
+#include "GL/renderer.hpp"
+#include "utility.hpp"
+
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <format>
+#include <limits>
+#include <ostream>
+#include <vector>
+
+namespace gl {
+    // Contiguous range of triangles that is culled as a whole.
+    struct Chunk {
+        size_t first = 0;
+        size_t count = 0;
+        glm::vec3 min{0.0f};
+        glm::vec3 max{0.0f};
+    };
+
+    // Draw parameters in the layout glMultiDrawArraysIndirect reads from GL_DRAW_INDIRECT_BUFFER.
+    struct DrawArraysIndirectCommand {
+        GLuint count;
+        GLuint instance_count;
+        GLuint first;
+        GLuint base_instance;
+    };
+
+    // Draw parameters in the layout glMultiDrawElementsIndirect reads from GL_DRAW_INDIRECT_BUFFER.
+    struct DrawElementsIndirectCommand {
+        GLuint count;
+        GLuint instance_count;
+        GLuint first_index;
+        GLint base_vertex;
+        GLuint base_instance;
+    };
+
+    // Chunks the last culling of a mesh removed, out of 'chunks'.
+    struct CullStats {
+        size_t chunks = 0;
+        size_t outside = 0;  // failed the frustum test
+        size_t occluded = 0; // hidden behind the occluders
+        size_t small = 0;    // covered no pixel center
+
+        bool operator==(const CullStats &other) const = default;
+    };
+
+    inline void PrintCullStats(std::ostream &out, const CullStats &stats) {
+        auto percent = [&](size_t count) { return stats.chunks ? 100.0 * count / stats.chunks : 0.0; };
+        out << std::format("culled chunks: {} of {} outside the frustum ({:.1f}%), {} occluded ({:.1f}%), {} too small ({:.1f}%)\n",
+                           stats.outside, stats.chunks, percent(stats.outside), stats.occluded, percent(stats.occluded),
+                           stats.small, percent(stats.small));
+    }
+
+    // Widens projected bounds against the rounding differences between the CPU and the vertex shader.
+    constexpr float SAMPLE_MARGIN = 1.0f / 64.0f;
+
+    // True when the projection of the box lies between the pixel centers in x or in y, so nothing in
+    // it makes a fragment. Boxes reaching behind the eye never are, nor is anything while the viewport
+    // of 'frustum' is unknown.
+    inline bool IsBetweenSamples(const Frustum &frustum, const glm::vec3 &min, const glm::vec3 &max) {
+        if (!(frustum.viewport.x > 0.0f && frustum.viewport.y > 0.0f))
+            return false;
+
+        glm::vec2 low{std::numeric_limits<float>::max()}, high{std::numeric_limits<float>::lowest()};
+        for (int corner = 0; corner < 8; ++corner) {
+            glm::vec3 point{(corner & 1) ? max.x : min.x, (corner & 2) ? max.y : min.y, (corner & 4) ? max.z : min.z};
+            glm::vec4 clip = frustum.view_projection * glm::vec4{point, 1.0f};
+            if (!(clip.w > 0.0f))
+                return false;
+
+            glm::vec2 screen{(clip.x / clip.w * 0.5f + 0.5f) * frustum.viewport.x, (clip.y / clip.w * 0.5f + 0.5f) * frustum.viewport.y};
+            low = glm::min(low, screen);
+            high = glm::max(high, screen);
+        }
+
+        // Pixel centers sit at half-integer window coordinates.
+        low -= glm::vec2{0.5f + SAMPLE_MARGIN};
+        high -= glm::vec2{0.5f - SAMPLE_MARGIN};
+        return std::ceil(low.x) > std::floor(high.x) || std::ceil(low.y) > std::floor(high.y);
+    }
+
+    // Where the chunks of a mesh are tested against the view frustum.
+    enum class Culling {
+        Cpu,
+        Gpu
+    };
+
+    inline bool HasMultiDrawIndirect() {
+        return GLAD_GL_VERSION_4_3 || GLAD_GL_ARB_multi_draw_indirect;
+    }
+
+    // Compute shaders and storage buffers come with GL 4.3, like indirect multi-draws.
+    inline bool HasGpuCulling() {
+        return GLAD_GL_VERSION_4_3;
+    }
+
+    constexpr unsigned int CULL_GROUP_SIZE = 64U; // local_size_x of shaders/cull.cs
+    constexpr int CULL_PLANES_LOCATION = 0;
+    constexpr int CULL_CHUNK_COUNT_LOCATION = 6;
+
+    constexpr int TRIANGLES_VIEW_PROJECTION_LOCATION = 0;
+    constexpr int TRIANGLES_VIEWPORT_LOCATION = 1;
+    constexpr int TRIANGLES_CHUNK_COUNT_LOCATION = 2;
+    constexpr GLuint MAX_WORK_GROUPS = 65535U; // the least GL_MAX_COMPUTE_WORK_GROUP_COUNT allows per axis
+
+    // Chunk culling on the GPU: a compute pass tests every chunk box and writes its indirect draw
+    // command, the draw then reads them without a round trip through the CPU. The draw count comes
+    // from the pass too when indirect parameters (GL 4.6 or ARB_indirect_parameters) are available.
+    // With triangle culling a second pass, shaders/triangles.cs, drops the triangles of the visible
+    // chunks that cover no pixel center and the draw goes through the indices of the rest.
+    class GpuCuller final {
+    public:
+        GpuCuller(const std::vector<Chunk> &chunks) : chunk_count_(chunks.size()) {
+            glRUN(glGenBuffers, 1, &chunks_);
+            glRUN(glGenBuffers, 1, &commands_);
+            glRUN(glGenBuffers, 1, &parameters_);
+
+            // Not used before the first frame, so the driver may build it while the rest loads.
+            program_.Build({{GL_COMPUTE_SHADER, file::FindFile("shaders", "cull", ".cs")}}, true);
+
+            // Until the first pass every chunk is drawn.
+            std::vector<GpuChunk> data(chunks.size());
+            std::vector<DrawArraysIndirectCommand> commands(chunks.size());
+            Parameters parameters{static_cast<GLuint>(chunks.size()), 0U, 0U};
+            for (size_t c = 0; c < chunks.size(); ++c) {
+                auto first = static_cast<GLuint>(chunks[c].first), count = static_cast<GLuint>(chunks[c].count);
+                data[c] = {glm::vec4{chunks[c].min, 1.0f}, glm::vec4{chunks[c].max, 1.0f}, first, count, {0U, 0U}};
+                commands[c] = {3U * count, 1U, 3U * first, 0U};
+                parameters.drawn_triangles += count;
+                triangle_count_ = std::max(triangle_count_, chunks[c].first + chunks[c].count);
+            }
+
+            glRUN(glBindBuffer, GL_SHADER_STORAGE_BUFFER, chunks_);
+            glRUN(glBufferData, GL_SHADER_STORAGE_BUFFER, data.size() * sizeof(GpuChunk), data.data(), GL_STATIC_DRAW);
+            glRUN(glBindBuffer, GL_SHADER_STORAGE_BUFFER, commands_);
+            glRUN(glBufferData, GL_SHADER_STORAGE_BUFFER, commands.size() * sizeof(DrawArraysIndirectCommand),
+                  commands.data(), GL_DYNAMIC_COPY);
+            glRUN(glBindBuffer, GL_SHADER_STORAGE_BUFFER, parameters_);
+            glRUN(glBufferData, GL_SHADER_STORAGE_BUFFER, sizeof(Parameters), &parameters, GL_DYNAMIC_COPY);
+            glRUN(glBindBuffer, GL_SHADER_STORAGE_BUFFER, 0);
+        }
+
+        GpuCuller(const GpuCuller &other) = delete;
+        GpuCuller &operator=(const GpuCuller &other) = delete;
+
+        ~GpuCuller() {
+            glDeleteBuffers(1, &chunks_);
+            glDeleteBuffers(1, &commands_);
+            glDeleteBuffers(1, &parameters_);
+            glDeleteBuffers(1, &indices_);
+            glDeleteBuffers(1, &element_commands_);
+        }
+
+        // Adds the triangle pass, which reads the positions from 'vertex_buffer', the buffer drawn.
+        void SetTriangleCulling(bool enabled, unsigned int vertex_buffer) {
+            vertex_buffer_ = enabled ? vertex_buffer : 0U;
+            if (!enabled || indices_ || chunk_count_ == 0)
+                return;
+
+            triangle_program_.Build({{GL_COMPUTE_SHADER, file::FindFile("shaders", "triangles", ".cs")}}, true);
+
+            glRUN(glGenBuffers, 1, &indices_);
+            glRUN(glGenBuffers, 1, &element_commands_);
+            glRUN(glBindBuffer, GL_SHADER_STORAGE_BUFFER, indices_);
+            glRUN(glBufferData, GL_SHADER_STORAGE_BUFFER, 3 * triangle_count_ * sizeof(GLuint), nullptr, GL_DYNAMIC_COPY);
+            glRUN(glBindBuffer, GL_SHADER_STORAGE_BUFFER, element_commands_);
+            glRUN(glBufferData, GL_SHADER_STORAGE_BUFFER, chunk_count_ * sizeof(DrawElementsIndirectCommand), nullptr,
+                  GL_DYNAMIC_COPY);
+            glRUN(glBindBuffer, GL_SHADER_STORAGE_BUFFER, 0);
+        }
+
+        // Runs the culling pass; it leaves its program bound, so call it before the draw program is used.
+        void Cull(const Frustum &frustum) {
+            if (chunk_count_ == 0)
+                return;
+
+            GLuint zero = 0;
+            glRUN(glBindBuffer, GL_SHADER_STORAGE_BUFFER, parameters_);
+            glRUN(glClearBufferData, GL_SHADER_STORAGE_BUFFER, GL_R32UI, GL_RED_INTEGER, GL_UNSIGNED_INT, &zero);
+            glRUN(glBindBuffer, GL_SHADER_STORAGE_BUFFER, 0);
+
+            program_.Run();
+            glRUN(glUniform4fv, CULL_PLANES_LOCATION, FRUSTUM_PLANE_COUNT, glm::value_ptr(frustum.planes[0]));
+            glRUN(glUniform1ui, CULL_CHUNK_COUNT_LOCATION, static_cast<GLuint>(chunk_count_));
+            glRUN(glBindBufferBase, GL_SHADER_STORAGE_BUFFER, 0, chunks_);
+            glRUN(glBindBufferBase, GL_SHADER_STORAGE_BUFFER, 1, commands_);
+            glRUN(glBindBufferBase, GL_SHADER_STORAGE_BUFFER, 2, parameters_);
+
+            auto groups = static_cast<GLuint>((chunk_count_ + CULL_GROUP_SIZE - 1) / CULL_GROUP_SIZE);
+            glRUN(glDispatchCompute, groups, 1U, 1U);
+            if (vertex_buffer_)
+                CullTriangles(frustum);
+            glRUN(glMemoryBarrier, GL_COMMAND_BARRIER_BIT);
+        }
+
+        // Draws the commands of the last pass from the bound vertex array.
+        void Draw() const {
+            if (chunk_count_ == 0)
+                return;
+
+            // The element buffer binding belongs to the bound vertex array, that of the mesh.
+            bool elements = vertex_buffer_ != 0U;
+            if (elements)
+                glRUN(glBindBuffer, GL_ELEMENT_ARRAY_BUFFER, indices_);
+            glRUN(glBindBuffer, GL_DRAW_INDIRECT_BUFFER, elements ? element_commands_ : commands_);
+
+            auto max_draw_count = static_cast<GLsizei>(chunk_count_);
+            if (GLAD_GL_VERSION_4_6 || GLAD_GL_ARB_indirect_parameters) {
+                glRUN(glBindBuffer, GL_PARAMETER_BUFFER, parameters_);
+                if (elements && GLAD_GL_VERSION_4_6)
+                    glRUN(glMultiDrawElementsIndirectCount, GL_TRIANGLES, GL_UNSIGNED_INT, nullptr, 0, max_draw_count, 0);
+                else if (elements)
+                    glRUN(glMultiDrawElementsIndirectCountARB, GL_TRIANGLES, GL_UNSIGNED_INT, nullptr, 0, max_draw_count, 0);
+                else if (GLAD_GL_VERSION_4_6)
+                    glRUN(glMultiDrawArraysIndirectCount, GL_TRIANGLES, nullptr, 0, max_draw_count, 0);
+                else
+                    glRUN(glMultiDrawArraysIndirectCountARB, GL_TRIANGLES, nullptr, 0, max_draw_count, 0);
+                glRUN(glBindBuffer, GL_PARAMETER_BUFFER, 0);
+            } else if (elements) {
+                glRUN(glMultiDrawElementsIndirect, GL_TRIANGLES, GL_UNSIGNED_INT, nullptr, max_draw_count, 0);
+            } else {
+                glRUN(glMultiDrawArraysIndirect, GL_TRIANGLES, nullptr, max_draw_count, 0);
+            }
+            glRUN(glBindBuffer, GL_DRAW_INDIRECT_BUFFER, 0);
+        }
+
+        // Reads back what the last pass let through. It waits for the GPU, so it is meant for statistics.
+        size_t ReadDrawnTriangleCount() const {
+            if (chunk_count_ == 0)
+                return 0;
+
+            Parameters parameters{};
+            glRUN(glMemoryBarrier, GL_BUFFER_UPDATE_BARRIER_BIT);
+            glRUN(glBindBuffer, GL_SHADER_STORAGE_BUFFER, parameters_);
+            glRUN(glGetBufferSubData, GL_SHADER_STORAGE_BUFFER, 0, sizeof(Parameters), &parameters);
+            glRUN(glBindBuffer, GL_SHADER_STORAGE_BUFFER, 0);
+            return parameters.drawn_triangles - parameters.small_triangles;
+        }
+
+    private:
+        void CullTriangles(const Frustum &frustum) {
+            glRUN(glMemoryBarrier, GL_SHADER_STORAGE_BARRIER_BIT);
+            triangle_program_.Run();
+            glRUN(glUniformMatrix4fv, TRIANGLES_VIEW_PROJECTION_LOCATION, 1, GL_FALSE, glm::value_ptr(frustum.view_projection));
+            glRUN(glUniform2f, TRIANGLES_VIEWPORT_LOCATION, frustum.viewport.x, frustum.viewport.y);
+            glRUN(glUniform1ui, TRIANGLES_CHUNK_COUNT_LOCATION, static_cast<GLuint>(chunk_count_));
+            glRUN(glBindBufferBase, GL_SHADER_STORAGE_BUFFER, 3, vertex_buffer_);
+            glRUN(glBindBufferBase, GL_SHADER_STORAGE_BUFFER, 4, indices_);
+            glRUN(glBindBufferBase, GL_SHADER_STORAGE_BUFFER, 5, element_commands_);
+
+            // A work group per chunk, on a second axis past what one axis is guaranteed to take.
+            auto groups = static_cast<GLuint>(chunk_count_);
+            auto rows = (groups + MAX_WORK_GROUPS - 1) / MAX_WORK_GROUPS;
+            glRUN(glDispatchCompute, std::min(groups, MAX_WORK_GROUPS), rows, 1U);
+            glRUN(glMemoryBarrier, GL_ELEMENT_ARRAY_BARRIER_BIT);
+        }
+
+        // std430 layouts of the buffers of shaders/cull.cs.
+        struct GpuChunk {
+            glm::vec4 min;
+            glm::vec4 max;
+            GLuint first;
+            GLuint count;
+            GLuint pad[2];
+        };
+
+        struct Parameters {
+            GLuint draw_count;
+            GLuint drawn_triangles;
+            GLuint small_triangles;
+        };
+
+        size_t chunk_count_ = 0;
+        size_t triangle_count_ = 0;
+        Program program_;
+        Program triangle_program_;
+        unsigned int chunks_ = 0;
+        unsigned int commands_ = 0;
+        unsigned int parameters_ = 0;
+        unsigned int vertex_buffer_ = 0; // not owned, 0 without triangle culling
+        unsigned int indices_ = 0;
+        unsigned int element_commands_ = 0;
+    }; // class GpuCuller
+} // namespace gl
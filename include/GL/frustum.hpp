@@ -0,0 +1,149 @@
+#pragma once
+
+#include "GL/gl.hpp"
+#include "simd.hpp"
+
+#include <array>
+#include <cstdint>
+#include <vector>
+
+#if TRIANGLES_X86_KERNELS
+    #include <immintrin.h>
+#endif
+
+namespace gl {
+    constexpr size_t FRUSTUM_PLANE_COUNT = 6U;
+    constexpr size_t BOX_BLOCK = 8U; // boxes are padded to whole blocks of the widest kernel
+
+    constexpr size_t NEAR_PLANE = 4U;
+
+    // Planes (a, b, c, d) of the view volume, the inside of each is a * x + b * y + c * z + d >= 0.
+    // The matrix they come from is kept for the tests that project onto the screen.
+    struct Frustum {
+        std::array<glm::vec4, FRUSTUM_PLANE_COUNT> planes;
+        glm::mat4 view_projection;
+        float pixel_scale = 0.0f;    // pixels a unit length spans at unit view depth, 0 if unknown
+        glm::vec2 viewport{0.0f};    // size in pixels, sampled once at every pixel center; 0 if unknown
+    };
+
+    // Gribb-Hartmann extraction: every clip-space bound -w <= x, y, z <= w is a sum or a difference
+    // of the matrix rows, and so a plane in world space when 'view_projection' maps from it.
+    inline Frustum GetFrustum(const glm::mat4 &view_projection) {
+        auto row = [&](int r) {
+            return glm::vec4{view_projection[0][r], view_projection[1][r], view_projection[2][r], view_projection[3][r]};
+        };
+
+        Frustum frustum;
+        frustum.view_projection = view_projection;
+        for (int axis = 0; axis < 3; ++axis) {
+            frustum.planes[2 * axis] = row(3) + row(axis);
+            frustum.planes[2 * axis + 1] = row(3) - row(axis);
+        }
+        return frustum;
+    }
+
+    // Axis-aligned boxes in structure-of-arrays form, padded with empty boxes to whole blocks.
+    struct BoxSet {
+        std::array<std::vector<float>, 3> min;
+        std::array<std::vector<float>, 3> max;
+        size_t count = 0;
+
+        void Resize(size_t box_count) {
+            count = box_count;
+            size_t padded = (box_count + BOX_BLOCK - 1) / BOX_BLOCK * BOX_BLOCK;
+            for (int axis = 0; axis < 3; ++axis) {
+                min[axis].assign(padded, 0.0f);
+                max[axis].assign(padded, 0.0f);
+            }
+        }
+
+        void Set(size_t index, const glm::vec3 &lo, const glm::vec3 &hi) {
+            for (int axis = 0; axis < 3; ++axis) {
+                min[axis][index] = lo[axis];
+                max[axis][index] = hi[axis];
+            }
+        }
+    };
+
+    namespace culling {
+        // A box is outside if its corner farthest along a plane normal is still behind that plane.
+        // Which corner that is depends only on the plane, so each plane reads one of the two
+        // coordinate arrays per axis and the test is the same multiply-add chain for all boxes.
+        namespace scalar {
+            inline void CullBoxes(const Frustum &frustum, const BoxSet &boxes, uint8_t *visible) {
+                for (size_t i = 0; i < boxes.count; ++i)
+                    visible[i] = 1U;
+
+                for (const auto &plane : frustum.planes) {
+                    const float *x = (plane.x >= 0.0f ? boxes.max : boxes.min)[0].data();
+                    const float *y = (plane.y >= 0.0f ? boxes.max : boxes.min)[1].data();
+                    const float *z = (plane.z >= 0.0f ? boxes.max : boxes.min)[2].data();
+                    for (size_t i = 0; i < boxes.count; ++i)
+                        visible[i] &= static_cast<uint8_t>(plane.x * x[i] + plane.y * y[i] + plane.z * z[i] + plane.w >= 0.0f);
+                }
+            }
+        } // namespace scalar
+
+#if TRIANGLES_X86_KERNELS
+        namespace sse42 {
+            TRIANGLES_TARGET("sse4.2") inline void CullBoxes(const Frustum &frustum, const BoxSet &boxes, uint8_t *visible) {
+                constexpr size_t WIDTH = 4U;
+                for (size_t i = 0; i < boxes.count; i += WIDTH) {
+                    __m128 inside = _mm_castsi128_ps(_mm_set1_epi32(-1));
+                    for (const auto &plane : frustum.planes) {
+                        __m128 x = _mm_loadu_ps((plane.x >= 0.0f ? boxes.max : boxes.min)[0].data() + i);
+                        __m128 y = _mm_loadu_ps((plane.y >= 0.0f ? boxes.max : boxes.min)[1].data() + i);
+                        __m128 z = _mm_loadu_ps((plane.z >= 0.0f ? boxes.max : boxes.min)[2].data() + i);
+                        __m128 dist = _mm_add_ps(_mm_add_ps(_mm_add_ps(_mm_mul_ps(_mm_set1_ps(plane.x), x), _mm_mul_ps(_mm_set1_ps(plane.y), y)),
+                                                            _mm_mul_ps(_mm_set1_ps(plane.z), z)), _mm_set1_ps(plane.w));
+                        inside = _mm_and_ps(inside, _mm_cmpge_ps(dist, _mm_setzero_ps()));
+                    }
+
+                    int mask = _mm_movemask_ps(inside);
+                    for (size_t l = 0; l < WIDTH && i + l < boxes.count; ++l)
+                        visible[i + l] = static_cast<uint8_t>((mask >> l) & 1);
+                }
+            }
+        } // namespace sse42
+
+        namespace avx2 {
+            TRIANGLES_TARGET("avx2") inline void CullBoxes(const Frustum &frustum, const BoxSet &boxes, uint8_t *visible) {
+                constexpr size_t WIDTH = 8U;
+                for (size_t i = 0; i < boxes.count; i += WIDTH) {
+                    __m256 inside = _mm256_castsi256_ps(_mm256_set1_epi32(-1));
+                    for (const auto &plane : frustum.planes) {
+                        __m256 x = _mm256_loadu_ps((plane.x >= 0.0f ? boxes.max : boxes.min)[0].data() + i);
+                        __m256 y = _mm256_loadu_ps((plane.y >= 0.0f ? boxes.max : boxes.min)[1].data() + i);
+                        __m256 z = _mm256_loadu_ps((plane.z >= 0.0f ? boxes.max : boxes.min)[2].data() + i);
+                        __m256 dist = _mm256_add_ps(_mm256_add_ps(_mm256_add_ps(_mm256_mul_ps(_mm256_set1_ps(plane.x), x),
+                                                                                _mm256_mul_ps(_mm256_set1_ps(plane.y), y)),
+                                                                  _mm256_mul_ps(_mm256_set1_ps(plane.z), z)), _mm256_set1_ps(plane.w));
+                        inside = _mm256_and_ps(inside, _mm256_cmp_ps(dist, _mm256_setzero_ps(), _CMP_GE_OQ));
+                    }
+
+                    int mask = _mm256_movemask_ps(inside);
+                    for (size_t l = 0; l < WIDTH && i + l < boxes.count; ++l)
+                        visible[i + l] = static_cast<uint8_t>((mask >> l) & 1);
+                }
+            }
+        } // namespace avx2
+#endif
+    } // namespace culling
+
+    // Writes 1 for every box that may intersect the frustum and 0 for those entirely outside one
+    // plane. Conservative: a box near a frustum corner can pass although it is outside.
+    inline void CullBoxes(const Frustum &frustum, const BoxSet &boxes, uint8_t *visible) {
+        using CullFunc = void (*)(const Frustum &, const BoxSet &, uint8_t *);
+        static const CullFunc cull = [] () -> CullFunc {
+            switch (simd::GetIsa()) {
+#if TRIANGLES_X86_KERNELS
+                case simd::Isa::AVX512:
+                case simd::Isa::AVX2:  return culling::avx2::CullBoxes;
+                case simd::Isa::SSE42: return culling::sse42::CullBoxes;
+#endif
+                default:               return culling::scalar::CullBoxes;
+            }
+        }();
+        cull(frustum, boxes, visible);
+    }
+} // namespace gl
@@ -7,11 +7,20 @@
 #include <glm/gtc/matrix_transform.hpp>
 #include <glm/gtc/type_ptr.hpp>
 
+#include "GL/profile.hpp"
+
+#include <algorithm>
+#include <atomic>
+#include <cstdlib>
+#include <cstring>
 #include <string>
+#include <string_view>
 #include <iostream>
 #include <fstream>
 #include <memory>
+#include <mutex>
 #include <format>
+#include <stdexcept>
 
 namespace gl {
     
@@ -32,46 +41,180 @@ namespace gl {
         std::string message_;
     }; // class glException
 
-    #define glRUN(func, ...) \
-        glRun(__LINE__, __FILE__, #func, func __VA_OPT__(,) __VA_ARGS__)
+    // Build-time ceiling of the GL error checking: 0 compiles glRUN down to the bare call unless the
+    // call profiler is compiled in, 1 keeps the asynchronous KHR_debug reporting, 2 also allows a
+    // glGetError check after every call.
+    #ifndef TRIANGLES_GL_CHECK
+        #ifdef NDEBUG
+            #define TRIANGLES_GL_CHECK 1
+        #else
+            #define TRIANGLES_GL_CHECK 2
+        #endif
+    #endif
+
+    enum class CheckLevel {
+        Off,   // errors are not looked for
+        Async, // the driver reports errors through the debug callback, tagged with the last call site
+        Sync   // glGetError after every call, the failing call throws at once
+    };
+
+    constexpr CheckLevel MAX_CHECK_LEVEL = static_cast<CheckLevel>(TRIANGLES_GL_CHECK);
 
-    void glCheckError(int line, std::string_view file_name, std::string_view func_name) {
+    inline std::string_view GetCheckLevelName(CheckLevel level) {
+        switch (level) {
+            case CheckLevel::Off:   return "off";
+            case CheckLevel::Async: return "async";
+            default:                return "sync";
+        }
+    }
+
+    inline CheckLevel ParseCheckLevel(std::string_view name) {
+        for (CheckLevel level : {CheckLevel::Off, CheckLevel::Async, CheckLevel::Sync})
+            if (name == GetCheckLevelName(level))
+                return level;
+        throw std::invalid_argument(std::format("Unknown GL check level '{}'", name));
+    }
+
+    // Checking level of this run: TRIANGLES_GL_CHECK if set, capped by the build-time level.
+    inline CheckLevel GetCheckLevel() {
+        static const CheckLevel level = [] {
+            if (const char *env = std::getenv("TRIANGLES_GL_CHECK"))
+                return std::min(MAX_CHECK_LEVEL, ParseCheckLevel(env));
+            return MAX_CHECK_LEVEL;
+        }();
+        return level;
+    }
+
+    namespace details {
+        inline std::atomic<const CallSite *> last_call{nullptr};
+        inline std::atomic<bool> has_pending_error{false};
+        inline std::mutex pending_mutex;
+        inline std::string pending_error;
+
+        // May run on a driver thread and after later calls were issued, so the call site is the
+        // last one recorded when the message arrived, not necessarily the call that caused it.
+        inline void APIENTRY OnDebugMessage(GLenum, GLenum type, GLuint id, GLenum severity, GLsizei length,
+                                            const GLchar *message, const void *) {
+            const CallSite *site = last_call.load(std::memory_order_relaxed);
+            std::string text = std::format("OpenGL debug message {} '{}' after calling the function '{}' in '{}' file on line '{}'.\n",
+                                           id, std::string_view{message, length < 0 ? std::strlen(message) : static_cast<size_t>(length)},
+                                           site ? site->func : "?", site ? site->file : "?", site ? site->line : 0);
+
+            if (type != GL_DEBUG_TYPE_ERROR) {
+                if (severity != GL_DEBUG_SEVERITY_NOTIFICATION)
+                    std::clog << text;
+                return;
+            }
+
+            std::lock_guard lock{pending_mutex};
+            if (!has_pending_error.load(std::memory_order_relaxed)) {
+                pending_error = std::move(text);
+                has_pending_error.store(true, std::memory_order_release);
+            }
+        }
+    } // namespace details
+
+    // Installs the debug callback if this run checks asynchronously; needs a current context.
+    inline void InitErrorChecking() {
+        if (GetCheckLevel() != CheckLevel::Async)
+            return;
+        if (!GLAD_GL_VERSION_4_3 && !GLAD_GL_KHR_debug) {
+            std::clog << "KHR_debug is not supported, OpenGL errors are not reported\n";
+            return;
+        }
+
+        glEnable(GL_DEBUG_OUTPUT);
+        glDebugMessageCallback(details::OnDebugMessage, nullptr);
+        glDebugMessageControl(GL_DONT_CARE, GL_DONT_CARE, GL_DEBUG_SEVERITY_NOTIFICATION, 0, nullptr, GL_FALSE);
+    }
+
+    // Rethrows the first error the debug callback received; called once per frame.
+    inline void CheckPendingError() {
+        if (!details::has_pending_error.load(std::memory_order_acquire))
+            return;
+
+        std::string message;
+        {
+            std::lock_guard lock{details::pending_mutex};
+            message = std::move(details::pending_error);
+            details::has_pending_error.store(false, std::memory_order_relaxed);
+        }
+        throw glException(message);
+    }
+
+    #if TRIANGLES_GL_CHECK == 0 && !TRIANGLES_GL_PROFILE
+        #define glRUN(func, ...) func(__VA_ARGS__)
+    #else
+        #define glRUN(func, ...) \
+            glRun([]() -> const ::gl::CallSite & { \
+                static constexpr ::gl::CallSite site{__LINE__, __FILE__, #func}; \
+                return site; \
+            }(), func __VA_OPT__(,) __VA_ARGS__)
+    #endif
+
+    inline void glCheckError(const CallSite &site) {
         auto error = glGetError();
         if (error != GL_NO_ERROR) {
             std::string mes = std::format("OpenGL lib '{}' error in '{}' file on line '{}', when calling the function '{}'.\n", 
-                error, file_name, line, func_name);
+                error, site.file, site.line, site.func);
 
             throw glException(mes);
         }
     }
 
     template <typename FuncT, typename... Args>
-    auto glRun(int line, std::string_view file_name, std::string_view func_name, 
-    FuncT func, Args&&... args) -> decltype(func(std::forward<Args>(args)...)) {
+    auto glRun(const CallSite &site, FuncT func, Args&&... args) -> decltype(func(std::forward<Args>(args)...)) {
+        CheckLevel level = GetCheckLevel();
+        if (level == CheckLevel::Async)
+            details::last_call.store(&site, std::memory_order_relaxed);
+
+        // Only the call itself is timed, the error check after it is not.
+        auto call = [&]() -> decltype(auto) {
+            if constexpr (TRIANGLES_GL_PROFILE) {
+                auto &profiler = CallProfiler::Get();
+                if (profiler.IsEnabled()) {
+                    struct Timer {
+                        CallProfiler &profiler;
+                        const CallSite &site;
+                        CallProfiler::Clock::time_point start = CallProfiler::Clock::now();
+                        ~Timer() { profiler.Record(site, start, CallProfiler::Clock::now()); }
+                    } timer{profiler, site};
+                    return func(std::forward<Args>(args)...);
+                }
+            }
+            return func(std::forward<Args>(args)...);
+        };
+
         if constexpr (std::is_void_v<decltype(func(std::forward<Args>(args)...))>) {
-            func(std::forward<Args>(args)...);
-            glCheckError(line, file_name, func_name);
+            call();
+            if (level == CheckLevel::Sync)
+                glCheckError(site);
         } else {
-            auto result = func(std::forward<Args>(args)...);
-            glCheckError(line, file_name, func_name);
+            auto result = call();
+            if (level == CheckLevel::Sync)
+                glCheckError(site);
             return result;
         }
     }
 
-    void SetUniform(unsigned int shader_id, std::string_view name, const glm::mat4 &value) {
-        auto loc = glRUN(glGetUniformLocation, shader_id, name.data());
-        glRUN(glUniformMatrix4fv, loc, 1, GL_FALSE, glm::value_ptr(value));
+    void SetUniform(int location, const glm::mat4 &value) {
+        glRUN(glUniformMatrix4fv, location, 1, GL_FALSE, glm::value_ptr(value));
     }
     
-    void SetUniform(unsigned int shader_id, std::string_view name, const glm::vec3 &value) {
-        auto loc = glRUN(glGetUniformLocation, shader_id, name.data());
-        glRUN(glUniform3fv, loc, 1, glm::value_ptr(value));
+    void SetUniform(int location, const glm::vec3 &value) {
+        glRUN(glUniform3fv, location, 1, glm::value_ptr(value));
     }
 
+    struct Frustum;
+
     class IMesh {
     public:
         virtual ~IMesh() {}
         virtual void Draw() = 0;
+
+        // Limits the next draws to what may be inside 'frustum'. It runs before the draw program is
+        // bound, so a mesh may use its own GPU passes; meshes without spatial structure draw everything.
+        virtual void Cull(const Frustum &) {}
     }; // class IMesh
 
     class IShader {
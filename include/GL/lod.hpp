@@ -0,0 +1,179 @@
+#pragma once
+
+#include "GL/gl.hpp"
+#include "GL/culling.hpp"
+#include "GL/frustum.hpp"
+
+#include <algorithm>
+#include <array>
+#include <cmath>
+#include <cstdint>
+#include <unordered_map>
+#include <vector>
+
+namespace gl {
+    constexpr size_t LOD_LEVELS = 4U;          // simplified levels per chunk at most
+    constexpr int LOD_FINEST_CELLS = 64;       // grid cells along the longest chunk side at the finest level
+    constexpr float LOD_MIN_REDUCTION = 0.75f; // a level is kept only below this share of the previous group count
+    constexpr float LOD_PIXEL_ERROR = 1.0f;    // largest projected corner displacement a level may cause
+    constexpr int LOD_CELL_BITS = 6;           // per axis, so a group key of three cells takes 54 bits
+    constexpr size_t LOD_GROUP_COLORS = 3U;    // colors a group's region is sized for: pending, intersected, separate
+    constexpr size_t LOD_OVERFLOW = SIZE_MAX;  // count of a level whose current colors do not fit its region
+
+    static_assert(LOD_FINEST_CELLS <= (1 << LOD_CELL_BITS));
+
+    // One simplified level of a chunk, made by vertex clustering: corners are snapped to the mean of
+    // all corners in their grid cell. Source triangles whose corners land in the same three cells, in
+    // the same winding, form a group and are drawn as one triangle per distinct color among them, so
+    // differently colored triangles are never merged. Triangles with two corners in one cell vanish.
+    struct LodLevel {
+        float error = 0.0f;              // world-space bound of the corner displacement
+        size_t first = 0;                // first vertex of the level's region in the mesh buffer
+        size_t capacity = 0;             // triangles the region can hold: one per member, LOD_GROUP_COLORS per group at most
+        size_t count = 0;                // triangles assembled for the current colors
+        std::vector<glm::vec3> corners;  // three per group
+        std::vector<uint32_t> offsets;   // group g has members[offsets[g] .. offsets[g + 1])
+        std::vector<uint32_t> members;   // mesh-wide triangle indices
+    };
+
+    struct ChunkLod {
+        std::vector<LodLevel> levels; // every level coarser than the one before
+    };
+
+    namespace details {
+        inline LodLevel BuildLodLevel(const std::vector<Vertex> &vertices, const Chunk &chunk, int cells_per_side) {
+            glm::vec3 extent = chunk.max - chunk.min;
+            float cell = std::max({extent.x, extent.y, extent.z}) / cells_per_side;
+
+            LodLevel level;
+            level.error = cell * std::sqrt(3.0f);
+            if (!(cell > 0.0f))
+                return level;
+
+            auto get_cell = [&](const glm::vec3 &point) {
+                uint32_t id = 0;
+                for (int axis = 0; axis < 3; ++axis) {
+                    int index = static_cast<int>((point[axis] - chunk.min[axis]) / cell);
+                    id = (id << LOD_CELL_BITS) | static_cast<uint32_t>(std::clamp(index, 0, cells_per_side - 1));
+                }
+                return id;
+            };
+
+            // Cell means of all corners of the chunk.
+            std::unordered_map<uint32_t, std::pair<glm::vec3, uint32_t>> means;
+            for (size_t v = 3 * chunk.first; v < 3 * (chunk.first + chunk.count); ++v) {
+                auto &[sum, count] = means[get_cell(vertices[v].position)];
+                sum += vertices[v].position;
+                ++count;
+            }
+
+            // Oriented cell triples, rotated to start at the smallest cell so the winding survives.
+            std::vector<std::pair<uint64_t, uint32_t>> keys;
+            keys.reserve(chunk.count);
+            for (size_t t = chunk.first; t < chunk.first + chunk.count; ++t) {
+                std::array<uint32_t, 3> ids;
+                for (int k = 0; k < 3; ++k)
+                    ids[k] = get_cell(vertices[3 * t + k].position);
+                if (ids[0] == ids[1] || ids[1] == ids[2] || ids[0] == ids[2])
+                    continue;
+
+                std::rotate(ids.begin(), std::min_element(ids.begin(), ids.end()), ids.end());
+                uint64_t key = (uint64_t{ids[0]} << (6 * LOD_CELL_BITS)) | (uint64_t{ids[1]} << (3 * LOD_CELL_BITS)) | ids[2];
+                keys.push_back({key, static_cast<uint32_t>(t)});
+            }
+            std::sort(keys.begin(), keys.end());
+
+            level.offsets.push_back(0U);
+            for (size_t begin = 0; begin < keys.size();) {
+                size_t end = begin + 1;
+                while (end < keys.size() && keys[end].first == keys[begin].first)
+                    ++end;
+
+                for (size_t m = begin; m < end; ++m)
+                    level.members.push_back(keys[m].second);
+                level.offsets.push_back(static_cast<uint32_t>(level.members.size()));
+                level.capacity += std::min(end - begin, LOD_GROUP_COLORS);
+
+                const auto *corner = &vertices[3 * keys[begin].second];
+                for (int k = 0; k < 3; ++k) {
+                    const auto &[sum, count] = means.at(get_cell(corner[k].position));
+                    level.corners.push_back(sum / static_cast<float>(count));
+                }
+                begin = end;
+            }
+
+            return level;
+        }
+    } // namespace details
+
+    inline ChunkLod BuildChunkLod(const std::vector<Vertex> &vertices, const Chunk &chunk) {
+        ChunkLod lod;
+        size_t previous = chunk.count;
+        for (int cells = LOD_FINEST_CELLS; cells >= 2 && lod.levels.size() < LOD_LEVELS; cells /= 2) {
+            auto level = details::BuildLodLevel(vertices, chunk, cells);
+            size_t groups = level.offsets.empty() ? 0 : level.offsets.size() - 1;
+            if (groups >= LOD_MIN_REDUCTION * previous)
+                continue;
+
+            previous = groups;
+            lod.levels.push_back(std::move(level));
+        }
+        return lod;
+    }
+
+    // Writes the level's triangles for the current colors of 'vertices' to 'out' and returns their
+    // count, or LOD_OVERFLOW if a group has more colors than the region was sized for. A triangle
+    // takes the normals of its members of that color, summed.
+    inline size_t AssembleLodLevel(const LodLevel &level, const std::vector<Vertex> &vertices, Vertex *out) {
+        struct Part {
+            glm::vec3 color;
+            glm::vec3 normal;
+        };
+
+        std::vector<Part> parts;
+        size_t count = 0;
+        for (size_t g = 0; g + 1 < level.offsets.size(); ++g) {
+            parts.clear();
+            for (uint32_t m = level.offsets[g]; m < level.offsets[g + 1]; ++m) {
+                const auto &source = vertices[3 * level.members[m]];
+                auto it = std::find_if(parts.begin(), parts.end(), [&](const Part &part) { return part.color == source.color; });
+                if (it == parts.end())
+                    parts.push_back({source.color, source.normal});
+                else
+                    it->normal += source.normal;
+            }
+
+            if (count + parts.size() > level.capacity)
+                return LOD_OVERFLOW;
+            for (const auto &part : parts) {
+                float length = glm::length(part.normal);
+                glm::vec3 normal = (length > 0.0f) ? part.normal / length : part.normal;
+                for (int k = 0; k < 3; ++k)
+                    out[3 * count + k] = {level.corners[3 * g + k], part.color, normal};
+                ++count;
+            }
+        }
+        return count;
+    }
+
+    // Coarsest level whose error projects to at most LOD_PIXEL_ERROR pixels at the nearest point of
+    // the chunk box, or -1 for the original triangles. Levels that overflowed their region are skipped.
+    inline int SelectLodLevel(const ChunkLod &lod, const Chunk &chunk, const Frustum &frustum) {
+        if (lod.levels.empty() || !(frustum.pixel_scale > 0.0f))
+            return -1;
+
+        const auto &vp = frustum.view_projection;
+        glm::vec4 depth_row{vp[0][3], vp[1][3], vp[2][3], vp[3][3]};
+        glm::vec3 nearest{depth_row.x >= 0.0f ? chunk.min.x : chunk.max.x, depth_row.y >= 0.0f ? chunk.min.y : chunk.max.y,
+                          depth_row.z >= 0.0f ? chunk.min.z : chunk.max.z};
+        float depth = glm::dot(glm::vec3{depth_row}, nearest) + depth_row.w;
+        if (!(depth > 0.0f))
+            return -1;
+
+        int selected = -1;
+        for (size_t l = 0; l < lod.levels.size(); ++l)
+            if (lod.levels[l].count != LOD_OVERFLOW && lod.levels[l].error * frustum.pixel_scale <= LOD_PIXEL_ERROR * depth)
+                selected = static_cast<int>(l);
+        return selected;
+    }
+} // namespace gl
@@ -1,6 +1,17 @@
 #pragma once
 
 #include "GL/gl.hpp"
+#include "GL/culling.hpp"
+#include "GL/frustum.hpp"
+#include "GL/lod.hpp"
+#include "GL/occlusion.hpp"
+
+#include <algorithm>
+#include <cstdint>
+#include <memory>
+#include <numeric>
+#include <stdexcept>
+#include <vector>
 
 namespace gl {
 
@@ -68,6 +79,17 @@ namespace gl {
         unsigned int VBO_ = 0;
     };    
 
+    inline void SetVertexAttribute() {
+        glRUN(glEnableVertexAttribArray, 0);
+        glRUN(glVertexAttribPointer, 0, 3, GL_FLOAT, GL_FALSE, 9 * sizeof(float), (void*)0);
+        
+        glRUN(glEnableVertexAttribArray, 1);
+        glRUN(glVertexAttribPointer, 1, 3, GL_FLOAT, GL_FALSE, 9 * sizeof(float), (void*) (sizeof(float) * 3));
+
+        glRUN(glEnableVertexAttribArray, 2);
+        glRUN(glVertexAttribPointer, 2, 3, GL_FLOAT, GL_FALSE, 9 * sizeof(float), (void*) (sizeof(float) * 6));
+    }
+
     class TriangleMesh final : public IMesh {
     public:
         TriangleMesh(const std::vector<Vertex> &vertices) : vertex_count_(vertices.size()) {
@@ -130,20 +152,350 @@ namespace gl {
             glRUN(glDrawArrays, GL_TRIANGLES, 0, vertex_count_);
         }
     private:
+        size_t vertex_count_ = 0;
+        VertexArrayObject VAO_;
+        VertexBufferObject VBO_;
+    }; // class Mesh
 
-        void SetVertexAttribute() {
-            glRUN(glEnableVertexAttribArray, 0);
-            glRUN(glVertexAttribPointer, 0, 3, GL_FLOAT, GL_FALSE, 9 * sizeof(float), (void*)0);
-            
-            glRUN(glEnableVertexAttribArray, 1);
-            glRUN(glVertexAttribPointer, 1, 3, GL_FLOAT, GL_FALSE, 9 * sizeof(float), (void*) (sizeof(float) * 3));
+    // Dirty triangles closer than this are uploaded in one range together with the clean ones between them.
+    constexpr size_t UPLOAD_GAP = 64U;
+
+    // Mesh whose triangle colors change while it is drawn. A CPU copy of the vertices is kept and
+    // only the changed ranges are sent to the GPU, right before the next draw. With chunks, only
+    // those that may be inside the view frustum are drawn. The visible ranges, neighbouring chunks
+    // merged, go to the GPU as one indirect multi-draw, so the number of GL calls per frame does not
+    // grow with the number of chunks. Without indirect draws glMultiDrawArrays takes the same ranges.
+    // With Culling::Gpu the chunks are tested by a compute pass that writes the draws itself.
+    // Chunks, or with GPU culling single triangles, that fall between the pixel centers can be dropped.
+    // CPU culling can also drop chunks hidden behind the nearest big ones, see OcclusionBuffer, and
+    // draw distant chunks from simplified copies kept after the vertices in the same buffer, see LodLevel.
+    class ProgressiveMesh final : public IMesh {
+    public:
+        ProgressiveMesh(std::vector<Vertex> vertices, std::vector<Chunk> chunks = {}, Culling culling = Culling::Cpu)
+            : vertices_(std::move(vertices)), chunks_(std::move(chunks)) {
+            if (culling == Culling::Gpu && !chunks_.empty()) {
+                if (!HasGpuCulling())
+                    throw glException("GPU culling needs OpenGL 4.3");
+                gpu_culler_ = std::make_unique<GpuCuller>(chunks_);
+            }
+
+            bounds_.Resize(chunks_.size());
+            for (size_t c = 0; c < chunks_.size(); ++c)
+                bounds_.Set(c, chunks_[c].min, chunks_[c].max);
+            visible_.assign(chunks_.size(), 1U);
+            commands_.reserve(chunks_.size());
 
-            glRUN(glEnableVertexAttribArray, 2);
-            glRUN(glVertexAttribPointer, 2, 3, GL_FLOAT, GL_FALSE, 9 * sizeof(float), (void*) (sizeof(float) * 6));
+            glRUN(glBindVertexArray, VAO_());
+            glRUN(glBindBuffer, GL_ARRAY_BUFFER, VBO_());
+            glRUN(glBufferData, GL_ARRAY_BUFFER, vertices_.size() * sizeof(gl::Vertex), vertices_.data(), GL_DYNAMIC_DRAW);
+
+            SetVertexAttribute();
+            glRUN(glBindBuffer, GL_ARRAY_BUFFER, 0);
+            glRUN(glBindVertexArray, 0);
+
+            if (!chunks_.empty() && !gpu_culler_ && HasMultiDrawIndirect()) {
+                glRUN(glBindBuffer, GL_DRAW_INDIRECT_BUFFER, indirect_buffer_());
+                glRUN(glBufferData, GL_DRAW_INDIRECT_BUFFER, GetIndirectBufferSize(), nullptr, GL_STREAM_DRAW);
+                glRUN(glBindBuffer, GL_DRAW_INDIRECT_BUFFER, 0);
+            }
         }
 
-        size_t vertex_count_ = 0;
+        ProgressiveMesh(const ProgressiveMesh &other) = delete;
+        ProgressiveMesh &operator=(const ProgressiveMesh &other) = delete;
+
+        void SetTriangleColor(size_t index, const glm::vec3 &color) {
+            if (3 * index + 2 >= vertices_.size())
+                throw std::out_of_range("Triangle index is out of mesh");
+
+            auto *vertex = &vertices_[3 * index];
+            if (vertex->color == color)
+                return;
+
+            for (size_t i = 0; i < 3; ++i)
+                vertex[i].color = color;
+            dirty_.push_back(index);
+
+            if (!lods_.empty()) {
+                auto it = std::upper_bound(chunks_.begin(), chunks_.end(), index,
+                                           [](size_t triangle, const Chunk &chunk) { return triangle < chunk.first; });
+                lod_dirty_.push_back(static_cast<size_t>(it - chunks_.begin()) - 1);
+            }
+        }
+
+        // Occlusion culling only applies to chunks culled on the CPU.
+        void SetOcclusionCulling(bool enabled) {
+            if (!enabled)
+                occlusion_.reset();
+            else if (!occlusion_)
+                occlusion_ = std::make_unique<OcclusionBuffer>();
+        }
+
+        // Drops what covers no pixel center: single triangles in the GPU culling pass, whole chunks on the CPU.
+        void SetSmallCulling(bool enabled) {
+            if (gpu_culler_)
+                gpu_culler_->SetTriangleCulling(enabled, VBO_());
+            small_culling_ = enabled;
+        }
+
+        // Builds the simplified levels of every chunk; like occlusion culling it only applies to chunks
+        // culled on the CPU. The vertex buffer grows to hold the levels next to the original triangles.
+        void SetLod(bool enabled) {
+            lods_.clear();
+            lod_levels_.clear();
+            lod_dirty_.clear();
+            if (!enabled || gpu_culler_ || chunks_.empty())
+                return;
+
+            lods_.resize(chunks_.size());
+            parallel::For(chunks_.size(), 1, [&](size_t begin, size_t end, size_t) {
+                for (size_t c = begin; c < end; ++c)
+                    lods_[c] = BuildChunkLod(vertices_, chunks_[c]);
+            });
+
+            size_t next = vertices_.size();
+            for (auto &lod : lods_)
+                for (auto &level : lod.levels) {
+                    level.first = next;
+                    next += 3 * level.capacity;
+                }
+            lod_vertices_.resize(next - vertices_.size());
+            lod_levels_.assign(chunks_.size(), -1);
+            lod_dirty_.resize(chunks_.size());
+            std::iota(lod_dirty_.begin(), lod_dirty_.end(), size_t{0});
+
+            glRUN(glBindBuffer, GL_ARRAY_BUFFER, VBO_());
+            glRUN(glBufferData, GL_ARRAY_BUFFER, next * sizeof(gl::Vertex), nullptr, GL_DYNAMIC_DRAW);
+            glRUN(glBufferSubData, GL_ARRAY_BUFFER, 0, vertices_.size() * sizeof(gl::Vertex), vertices_.data());
+            glRUN(glBindBuffer, GL_ARRAY_BUFFER, 0);
+            dirty_.clear();
+        }
+
+        void Cull(const Frustum &frustum) override {
+            if (gpu_culler_)
+                return gpu_culler_->Cull(frustum);
+
+            if (chunks_.empty())
+                return;
+
+            CullBoxes(frustum, bounds_, visible_.data());
+            stats_ = {chunks_.size(), 0U, 0U, 0U};
+            stats_.outside = chunks_.size() - std::count(visible_.begin(), visible_.end(), uint8_t{1});
+            if (small_culling_)
+                CullSmall(frustum);
+            if (occlusion_)
+                CullOccluded(frustum);
+
+            if (!lods_.empty())
+                parallel::For(chunks_.size(), parallel::DEFAULT_GRAIN, [&](size_t begin, size_t end, size_t) {
+                    for (size_t c = begin; c < end; ++c)
+                        lod_levels_[c] = visible_[c] ? SelectLodLevel(lods_[c], chunks_[c], frustum) : -1;
+                });
+        }
+
+        // Draws the chunks that passed the last Cull, all of them before the first one.
+        void Draw() override {
+            glRUN(glBindVertexArray, VAO_());
+            Upload();
+
+            if (chunks_.empty()) {
+                glRUN(glDrawArrays, GL_TRIANGLES, 0, vertices_.size());
+                drawn_triangles_ = vertices_.size() / 3;
+            } else if (gpu_culler_) {
+                gpu_culler_->Draw();
+            } else {
+                CollectCommands();
+                Submit();
+            }
+        }
+
+        // Triangles sent to the GPU by the last draw. With GPU culling this waits for the culling pass.
+        size_t GetDrawnTriangleCount() const {
+            return gpu_culler_ ? gpu_culler_->ReadDrawnTriangleCount() : drawn_triangles_;
+        }
+
+        // Chunks removed by the last CPU culling.
+        const CullStats &GetCullStats() const {
+            return stats_;
+        }
+
+    private:
+        void CullSmall(const Frustum &frustum) {
+            std::vector<size_t> small(parallel::GetThreadCount(), 0U);
+            parallel::For(chunks_.size(), parallel::DEFAULT_GRAIN, [&](size_t begin, size_t end, size_t thread) {
+                for (size_t c = begin; c < end; ++c)
+                    if (visible_[c] && IsBetweenSamples(frustum, chunks_[c].min, chunks_[c].max)) {
+                        visible_[c] = 0U;
+                        ++small[thread];
+                    }
+            });
+            stats_.small = std::accumulate(small.begin(), small.end(), size_t{0});
+        }
+
+        void CullOccluded(const Frustum &frustum) {
+            auto occluders = SelectOccluders(frustum, chunks_, visible_);
+            occlusion_->Render(frustum.view_projection, vertices_, chunks_, occluders);
+
+            std::vector<size_t> occluded(parallel::GetThreadCount(), 0U);
+            parallel::For(chunks_.size(), parallel::DEFAULT_GRAIN, [&](size_t begin, size_t end, size_t thread) {
+                for (size_t c = begin; c < end; ++c)
+                    if (visible_[c] && occlusion_->IsOccluded(chunks_[c].min, chunks_[c].max)) {
+                        visible_[c] = 0U;
+                        ++occluded[thread];
+                    }
+            });
+            stats_.occluded = std::accumulate(occluded.begin(), occluded.end(), size_t{0});
+        }
+
+        // Visible ranges of the last CPU culling, neighbouring chunks drawn in full merged. A chunk drawn
+        // from a simplified level takes a command of its own.
+        void CollectCommands() {
+            commands_.clear();
+            drawn_triangles_ = 0;
+            // Colors may have changed since the last Cull, a level that no longer fits draws the original triangles.
+            auto get_level = [&](size_t c) {
+                int level = lod_levels_.empty() ? -1 : lod_levels_[c];
+                return (level >= 0 && lods_[c].levels[level].count == LOD_OVERFLOW) ? -1 : level;
+            };
+
+            for (size_t begin = 0; begin < chunks_.size();) {
+                if (!visible_[begin]) {
+                    ++begin;
+                    continue;
+                }
+
+                if (int level = get_level(begin); level >= 0) {
+                    const auto &lod = lods_[begin].levels[level];
+                    if (lod.count)
+                        commands_.push_back({static_cast<GLuint>(3 * lod.count), 1U, static_cast<GLuint>(lod.first), 0U});
+                    drawn_triangles_ += lod.count;
+                    ++begin;
+                    continue;
+                }
+
+                size_t end = begin + 1;
+                while (end < chunks_.size() && visible_[end] && get_level(end) < 0 &&
+                       chunks_[end].first == chunks_[end - 1].first + chunks_[end - 1].count)
+                    ++end;
+
+                size_t first = chunks_[begin].first;
+                size_t count = chunks_[end - 1].first + chunks_[end - 1].count - first;
+                commands_.push_back({static_cast<GLuint>(3 * count), 1U, static_cast<GLuint>(3 * first), 0U});
+                drawn_triangles_ += count;
+                begin = end;
+            }
+        }
+
+        size_t GetIndirectBufferSize() const {
+            return chunks_.size() * sizeof(DrawArraysIndirectCommand);
+        }
+
+        void Submit() {
+            if (commands_.empty())
+                return;
+
+            auto draw_count = static_cast<GLsizei>(commands_.size());
+            if (HasMultiDrawIndirect()) {
+                // Orphaning the whole buffer lets the driver hand out fresh storage while the last
+                // frame's commands may still be read.
+                glRUN(glBindBuffer, GL_DRAW_INDIRECT_BUFFER, indirect_buffer_());
+                glRUN(glBufferData, GL_DRAW_INDIRECT_BUFFER, GetIndirectBufferSize(), nullptr, GL_STREAM_DRAW);
+                glRUN(glBufferSubData, GL_DRAW_INDIRECT_BUFFER, 0, commands_.size() * sizeof(DrawArraysIndirectCommand),
+                      commands_.data());
+                glRUN(glMultiDrawArraysIndirect, GL_TRIANGLES, nullptr, draw_count, 0);
+                glRUN(glBindBuffer, GL_DRAW_INDIRECT_BUFFER, 0);
+                return;
+            }
+
+            firsts_.clear();
+            counts_.clear();
+            for (const auto &command : commands_) {
+                firsts_.push_back(static_cast<GLint>(command.first));
+                counts_.push_back(static_cast<GLsizei>(command.count));
+            }
+            glRUN(glMultiDrawArrays, GL_TRIANGLES, firsts_.data(), counts_.data(), draw_count);
+        }
+
+        void Upload() {
+            UploadLod();
+            if (dirty_.empty())
+                return;
+
+            std::sort(dirty_.begin(), dirty_.end());
+            glRUN(glBindBuffer, GL_ARRAY_BUFFER, VBO_());
+
+            for (size_t begin = 0; begin < dirty_.size();) {
+                size_t end = begin + 1;
+                while (end < dirty_.size() && dirty_[end] - dirty_[end - 1] <= UPLOAD_GAP)
+                    ++end;
+
+                size_t first = 3 * dirty_[begin];
+                size_t count = 3 * (dirty_[end - 1] + 1) - first;
+                glRUN(glBufferSubData, GL_ARRAY_BUFFER, first * sizeof(gl::Vertex), count * sizeof(gl::Vertex),
+                      vertices_.data() + first);
+                begin = end;
+            }
+
+            glRUN(glBindBuffer, GL_ARRAY_BUFFER, 0);
+            dirty_.clear();
+        }
+
+        // Reassembles the levels of the chunks whose colors changed. The levels of neighbouring chunks
+        // are neighbours in the buffer too, so a run of dirty chunks is one upload.
+        void UploadLod() {
+            if (lod_dirty_.empty())
+                return;
+
+            std::sort(lod_dirty_.begin(), lod_dirty_.end());
+            lod_dirty_.erase(std::unique(lod_dirty_.begin(), lod_dirty_.end()), lod_dirty_.end());
+            parallel::For(lod_dirty_.size(), 1, [&](size_t begin, size_t end, size_t) {
+                for (size_t d = begin; d < end; ++d)
+                    for (auto &level : lods_[lod_dirty_[d]].levels) {
+                        auto *out = lod_vertices_.data() + (level.first - vertices_.size());
+                        level.count = AssembleLodLevel(level, vertices_, out);
+                    }
+            });
+
+            glRUN(glBindBuffer, GL_ARRAY_BUFFER, VBO_());
+            for (size_t begin = 0; begin < lod_dirty_.size();) {
+                size_t end = begin + 1;
+                while (end < lod_dirty_.size() && lod_dirty_[end] == lod_dirty_[end - 1] + 1)
+                    ++end;
+
+                size_t first = SIZE_MAX, last = 0;
+                for (size_t d = begin; d < end; ++d)
+                    for (const auto &level : lods_[lod_dirty_[d]].levels) {
+                        first = std::min(first, level.first);
+                        last = std::max(last, level.first + 3 * level.capacity);
+                    }
+                if (first < last)
+                    glRUN(glBufferSubData, GL_ARRAY_BUFFER, first * sizeof(gl::Vertex), (last - first) * sizeof(gl::Vertex),
+                          lod_vertices_.data() + (first - vertices_.size()));
+                begin = end;
+            }
+
+            glRUN(glBindBuffer, GL_ARRAY_BUFFER, 0);
+            lod_dirty_.clear();
+        }
+
+        std::vector<Vertex> vertices_;
+        std::vector<size_t> dirty_;
+        std::vector<Chunk> chunks_;
+        BoxSet bounds_;
+        std::vector<uint8_t> visible_;
+        std::vector<DrawArraysIndirectCommand> commands_;
+        std::vector<GLint> firsts_;
+        std::vector<GLsizei> counts_;
+        size_t drawn_triangles_ = 0;
+        CullStats stats_;
+        std::unique_ptr<GpuCuller> gpu_culler_;
+        std::unique_ptr<OcclusionBuffer> occlusion_;
+        bool small_culling_ = false;
+        std::vector<ChunkLod> lods_;
+        std::vector<int> lod_levels_;
+        std::vector<size_t> lod_dirty_;
+        std::vector<Vertex> lod_vertices_; // CPU copy of the levels, after the vertices in the buffer
         VertexArrayObject VAO_;
         VertexBufferObject VBO_;
-    }; // class Mesh
+        VertexBufferObject indirect_buffer_;
+    }; // class ProgressiveMesh
 } // namespace gl
\ No newline at end of file
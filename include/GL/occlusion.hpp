@@ -0,0 +1,306 @@
+#pragma once
+
+#include "GL/gl.hpp"
+#include "GL/culling.hpp"
+#include "GL/frustum.hpp"
+#include "parallel.hpp"
+#include "simd.hpp"
+
+#include <algorithm>
+#include <array>
+#include <cmath>
+#include <cstdint>
+#include <limits>
+#include <vector>
+
+#if TRIANGLES_X86_KERNELS
+    #include <immintrin.h>
+#endif
+
+namespace gl {
+    constexpr int OCCLUSION_WIDTH = 256;  // a multiple of the 8 pixels the wide kernel writes at once
+    constexpr int OCCLUSION_HEIGHT = 192;
+    constexpr int OCCLUSION_BAND_ROWS = 16; // rows a rasterizer thread owns
+    constexpr size_t OCCLUDER_TRIANGLES = 16384U;
+    constexpr float OCCLUSION_MIN_W = 1e-6f;
+
+    // Occluder triangle in depth buffer space: x, y in pixels, z the depth in normalized device coordinates.
+    // Edge functions and depth are planes a * x + b * y + c over pixel centers; inside is where all edges are >= 0.
+    // Both kernels evaluate them as a * x + (b * y + c), so they cover the same pixels.
+    struct ScreenTriangle {
+        std::array<glm::vec3, 3> edges;
+        glm::vec3 depth;
+        int x_begin = 0, x_end = 0;
+        int y_begin = 0, y_end = 0;
+    };
+
+    namespace occlusion {
+        // Returns false for triangles that reach in front of the near plane, cover no pixel center or
+        // are degenerate. Geometry the camera clips away hides nothing, and dropping an occluder only
+        // costs culling, so such triangles are rejected rather than clipped.
+        inline bool SetupTriangle(const std::array<glm::vec4, 3> &clip, ScreenTriangle &tri) {
+            std::array<glm::vec3, 3> v;
+            for (int k = 0; k < 3; ++k) {
+                if (!(clip[k].w > OCCLUSION_MIN_W) || !(clip[k].z >= -clip[k].w))
+                    return false;
+                glm::vec3 ndc = glm::vec3{clip[k]} / clip[k].w;
+                v[k] = {(ndc.x * 0.5f + 0.5f) * OCCLUSION_WIDTH, (ndc.y * 0.5f + 0.5f) * OCCLUSION_HEIGHT, ndc.z};
+            }
+
+            float min_x = std::min({v[0].x, v[1].x, v[2].x}), max_x = std::max({v[0].x, v[1].x, v[2].x});
+            float min_y = std::min({v[0].y, v[1].y, v[2].y}), max_y = std::max({v[0].y, v[1].y, v[2].y});
+            tri.x_begin = std::max(0, static_cast<int>(std::ceil(min_x - 0.5f)));
+            tri.x_end = std::min(OCCLUSION_WIDTH, static_cast<int>(std::floor(max_x - 0.5f)) + 1);
+            tri.y_begin = std::max(0, static_cast<int>(std::ceil(min_y - 0.5f)));
+            tri.y_end = std::min(OCCLUSION_HEIGHT, static_cast<int>(std::floor(max_y - 0.5f)) + 1);
+            if (tri.x_begin >= tri.x_end || tri.y_begin >= tri.y_end)
+                return false;
+
+            // Edge k is opposite to corner k, its value at a point is that corner's barycentric weight
+            // times the area. The two triangles of a shared edge compute exactly negated values for it,
+            // so no pixel center on the edge is lost between them.
+            for (int k = 0; k < 3; ++k) {
+                const auto &a = v[(k + 1) % 3], &b = v[(k + 2) % 3];
+                tri.edges[k] = {a.y - b.y, b.x - a.x, a.x * b.y - a.y * b.x};
+            }
+
+            float area = tri.edges[0].x * v[0].x + tri.edges[0].y * v[0].y + tri.edges[0].z;
+            if (!(std::abs(area) > 0.0f))
+                return false;
+
+            tri.depth = (tri.edges[0] * v[0].z + tri.edges[1] * v[1].z + tri.edges[2] * v[2].z) / area;
+            if (area < 0.0f)
+                for (auto &edge : tri.edges)
+                    edge = -edge;
+            return true;
+        }
+
+        namespace scalar {
+            inline void RasterizeTriangle(const ScreenTriangle &tri, float *depth, int y_begin, int y_end) {
+                for (int y = std::max(y_begin, tri.y_begin); y < std::min(y_end, tri.y_end); ++y) {
+                    float cy = y + 0.5f;
+                    float *row = depth + y * OCCLUSION_WIDTH;
+                    for (int x = tri.x_begin; x < tri.x_end; ++x) {
+                        float cx = x + 0.5f;
+                        bool inside = true;
+                        for (const auto &edge : tri.edges)
+                            inside = inside && (edge.x * cx + (edge.y * cy + edge.z) >= 0.0f);
+                        if (inside)
+                            row[x] = std::min(row[x], tri.depth.x * cx + (tri.depth.y * cy + tri.depth.z));
+                    }
+                }
+            }
+        } // namespace scalar
+
+#if TRIANGLES_X86_KERNELS
+        namespace avx2 {
+            // Eight pixel centers of a row at a time; blocks start at multiples of eight, so the
+            // loads and stores stay inside the row.
+            TRIANGLES_TARGET("avx2") inline void RasterizeTriangle(const ScreenTriangle &tri, float *depth, int y_begin,
+                                                                   int y_end) {
+                constexpr int WIDTH = 8;
+                const __m256 lanes = _mm256_setr_ps(0.5f, 1.5f, 2.5f, 3.5f, 4.5f, 5.5f, 6.5f, 7.5f);
+                const __m256 zero = _mm256_setzero_ps();
+                int x_first = tri.x_begin / WIDTH * WIDTH;
+
+                for (int y = std::max(y_begin, tri.y_begin); y < std::min(y_end, tri.y_end); ++y) {
+                    float cy = y + 0.5f;
+                    float *row = depth + y * OCCLUSION_WIDTH;
+                    for (int x = x_first; x < tri.x_end; x += WIDTH) {
+                        __m256 cx = _mm256_add_ps(_mm256_set1_ps(static_cast<float>(x)), lanes);
+                        __m256 inside = _mm256_castsi256_ps(_mm256_set1_epi32(-1));
+                        for (const auto &edge : tri.edges) {
+                            __m256 value = _mm256_add_ps(_mm256_mul_ps(_mm256_set1_ps(edge.x), cx),
+                                                         _mm256_set1_ps(edge.y * cy + edge.z));
+                            inside = _mm256_and_ps(inside, _mm256_cmp_ps(value, zero, _CMP_GE_OQ));
+                        }
+                        if (_mm256_movemask_ps(inside) == 0)
+                            continue;
+
+                        __m256 z = _mm256_add_ps(_mm256_mul_ps(_mm256_set1_ps(tri.depth.x), cx),
+                                                 _mm256_set1_ps(tri.depth.y * cy + tri.depth.z));
+                        __m256 old = _mm256_loadu_ps(row + x);
+                        _mm256_storeu_ps(row + x, _mm256_blendv_ps(old, _mm256_min_ps(old, z), inside));
+                    }
+                }
+            }
+        } // namespace avx2
+#endif
+
+        inline void RasterizeTriangle(const ScreenTriangle &tri, float *depth, int y_begin, int y_end) {
+            using RasterizeFunc = void (*)(const ScreenTriangle &, float *, int, int);
+            static const RasterizeFunc rasterize = [] () -> RasterizeFunc {
+                switch (simd::GetIsa()) {
+#if TRIANGLES_X86_KERNELS
+                    case simd::Isa::AVX512:
+                    case simd::Isa::AVX2:  return avx2::RasterizeTriangle;
+#endif
+                    default:               return scalar::RasterizeTriangle;
+                }
+            }();
+            rasterize(tri, depth, y_begin, y_end);
+        }
+    } // namespace occlusion
+
+    // Chunks nearest to the near plane, up to 'max_triangles' triangles in total. The nearest
+    // surfaces hide the most, and the budget bounds the rasterization cost however the scene is
+    // chunked. Only chunks that passed the frustum test are candidates.
+    inline std::vector<size_t> SelectOccluders(const Frustum &frustum, const std::vector<Chunk> &chunks,
+                                               const std::vector<uint8_t> &visible, size_t max_triangles = OCCLUDER_TRIANGLES) {
+        const auto &near = frustum.planes[NEAR_PLANE];
+        glm::vec3 normal{near};
+
+        std::vector<size_t> candidates;
+        std::vector<float> distances(chunks.size(), 0.0f);
+        for (size_t c = 0; c < chunks.size(); ++c) {
+            if (!visible[c])
+                continue;
+
+            // The box corner nearest to the plane, the normal length only scales every distance alike.
+            glm::vec3 corner{normal.x >= 0.0f ? chunks[c].min.x : chunks[c].max.x,
+                             normal.y >= 0.0f ? chunks[c].min.y : chunks[c].max.y,
+                             normal.z >= 0.0f ? chunks[c].min.z : chunks[c].max.z};
+            distances[c] = glm::dot(normal, corner) + near.w;
+            candidates.push_back(c);
+        }
+
+        std::sort(candidates.begin(), candidates.end(), [&](size_t lhs, size_t rhs) { return distances[lhs] < distances[rhs]; });
+
+        size_t count = 0, triangles = 0;
+        while (count < candidates.size() && triangles + chunks[candidates[count]].count <= max_triangles)
+            triangles += chunks[candidates[count++]].count;
+        candidates.resize(count);
+        return candidates;
+    }
+
+    // Low-resolution depth buffer of the occluder triangles and its max pyramid. A box is hidden
+    // when every texel under its screen rectangle has something nearer than the box's nearest
+    // point. The occluders are sampled at texel centers and boxes are tested with a texel of margin,
+    // but a gap narrower than a texel between occluders can still be lost.
+    class OcclusionBuffer final {
+    public:
+        OcclusionBuffer() {
+            for (int width = OCCLUSION_WIDTH, height = OCCLUSION_HEIGHT;; width = (width + 1) / 2, height = (height + 1) / 2) {
+                sizes_.push_back({width, height});
+                levels_.emplace_back(static_cast<size_t>(width) * height);
+                if (width == 1 && height == 1)
+                    break;
+            }
+        }
+
+        void Render(const glm::mat4 &view_projection, const std::vector<Vertex> &vertices, const std::vector<Chunk> &chunks,
+                    const std::vector<size_t> &occluders) {
+            view_projection_ = view_projection;
+
+            ranges_.assign(1, 0U);
+            for (auto c : occluders)
+                ranges_.push_back(ranges_.back() + chunks[c].count);
+            triangles_.resize(ranges_.back());
+            valid_.resize(ranges_.back());
+
+            parallel::For(triangles_.size(), parallel::DEFAULT_GRAIN, [&](size_t begin, size_t end, size_t) {
+                size_t k = std::upper_bound(ranges_.begin(), ranges_.end(), begin) - ranges_.begin() - 1;
+                for (size_t i = begin; i < end; ++i) {
+                    while (i >= ranges_[k + 1])
+                        ++k;
+                    const auto *vertex = &vertices[3 * (chunks[occluders[k]].first + i - ranges_[k])];
+                    std::array<glm::vec4, 3> clip;
+                    for (int corner = 0; corner < 3; ++corner)
+                        clip[corner] = view_projection * glm::vec4{vertex[corner].position, 1.0f};
+                    valid_[i] = occlusion::SetupTriangle(clip, triangles_[i]);
+                }
+            });
+
+            // Triangles are binned into bands of rows, and every thread rasterizes whole bands.
+            size_t band_count = (OCCLUSION_HEIGHT + OCCLUSION_BAND_ROWS - 1) / OCCLUSION_BAND_ROWS;
+            bands_.resize(band_count);
+            for (auto &band : bands_)
+                band.clear();
+            for (size_t i = 0; i < triangles_.size(); ++i) {
+                if (!valid_[i])
+                    continue;
+                int last = (triangles_[i].y_end - 1) / OCCLUSION_BAND_ROWS;
+                for (int band = triangles_[i].y_begin / OCCLUSION_BAND_ROWS; band <= last; ++band)
+                    bands_[band].push_back(static_cast<uint32_t>(i));
+            }
+
+            auto &depth = levels_[0];
+            std::fill(depth.begin(), depth.end(), std::numeric_limits<float>::infinity());
+            parallel::For(band_count, 1, [&](size_t begin, size_t end, size_t) {
+                for (size_t band = begin; band < end; ++band) {
+                    int y_begin = static_cast<int>(band) * OCCLUSION_BAND_ROWS;
+                    int y_end = std::min(OCCLUSION_HEIGHT, y_begin + OCCLUSION_BAND_ROWS);
+                    for (auto i : bands_[band])
+                        occlusion::RasterizeTriangle(triangles_[i], depth.data(), y_begin, y_end);
+                }
+            });
+
+            BuildPyramid();
+        }
+
+        bool IsOccluded(const glm::vec3 &min, const glm::vec3 &max) const {
+            float min_x = std::numeric_limits<float>::max(), max_x = std::numeric_limits<float>::lowest();
+            float min_y = min_x, max_y = max_x, min_z = min_x;
+            for (int corner = 0; corner < 8; ++corner) {
+                glm::vec4 clip = view_projection_ * glm::vec4{(corner & 1) ? max.x : min.x, (corner & 2) ? max.y : min.y,
+                                                              (corner & 4) ? max.z : min.z, 1.0f};
+                if (!(clip.w > OCCLUSION_MIN_W))
+                    return false;
+
+                glm::vec3 ndc = glm::vec3{clip} / clip.w;
+                min_x = std::min(min_x, ndc.x);
+                max_x = std::max(max_x, ndc.x);
+                min_y = std::min(min_y, ndc.y);
+                max_y = std::max(max_y, ndc.y);
+                min_z = std::min(min_z, ndc.z);
+            }
+
+            // One texel of margin: the occluders are only known at texel centers.
+            int x0 = std::max(0, static_cast<int>(std::floor((min_x * 0.5f + 0.5f) * OCCLUSION_WIDTH)) - 1);
+            int x1 = std::min(OCCLUSION_WIDTH - 1, static_cast<int>(std::floor((max_x * 0.5f + 0.5f) * OCCLUSION_WIDTH)) + 1);
+            int y0 = std::max(0, static_cast<int>(std::floor((min_y * 0.5f + 0.5f) * OCCLUSION_HEIGHT)) - 1);
+            int y1 = std::min(OCCLUSION_HEIGHT - 1, static_cast<int>(std::floor((max_y * 0.5f + 0.5f) * OCCLUSION_HEIGHT)) + 1);
+            if (x0 > x1 || y0 > y1)
+                return false;
+
+            // The coarsest level still below 2 x 2 texels for the rectangle, so at most four reads.
+            size_t level = 0;
+            while (level + 1 < levels_.size() && ((x1 >> level) - (x0 >> level) > 1 || (y1 >> level) - (y0 >> level) > 1))
+                ++level;
+
+            const auto &texels = levels_[level];
+            int width = sizes_[level][0];
+            for (int y = y0 >> level; y <= (y1 >> level); ++y)
+                for (int x = x0 >> level; x <= (x1 >> level); ++x)
+                    if (!(texels[y * width + x] < min_z))
+                        return false;
+            return true;
+        }
+
+    private:
+        // Every texel of a level keeps the farthest depth of the 2 x 2 texels below it.
+        void BuildPyramid() {
+            for (size_t level = 1; level < levels_.size(); ++level) {
+                const auto &fine = levels_[level - 1];
+                auto &coarse = levels_[level];
+                int fine_width = sizes_[level - 1][0], fine_height = sizes_[level - 1][1];
+                int width = sizes_[level][0], height = sizes_[level][1];
+                for (int y = 0; y < height; ++y)
+                    for (int x = 0; x < width; ++x) {
+                        int x0 = 2 * x, x1 = std::min(2 * x + 1, fine_width - 1);
+                        int y0 = 2 * y, y1 = std::min(2 * y + 1, fine_height - 1);
+                        coarse[y * width + x] = std::max({fine[y0 * fine_width + x0], fine[y0 * fine_width + x1],
+                                                          fine[y1 * fine_width + x0], fine[y1 * fine_width + x1]});
+                    }
+            }
+        }
+
+        glm::mat4 view_projection_{1.0f};
+        std::vector<size_t> ranges_;
+        std::vector<ScreenTriangle> triangles_;
+        std::vector<uint8_t> valid_;
+        std::vector<std::vector<uint32_t>> bands_;
+        std::vector<std::array<int, 2>> sizes_;
+        std::vector<std::vector<float>> levels_; // level 0 is the depth buffer itself
+    }; // class OcclusionBuffer
+} // namespace gl
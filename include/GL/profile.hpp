@@ -0,0 +1,189 @@
+#pragma once
+
+#include <algorithm>
+#include <chrono>
+#include <cstdint>
+#include <cstdlib>
+#include <format>
+#include <fstream>
+#include <ostream>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+#include <vector>
+
+// Compiles the per-call timing into glRUN; TRIANGLES_GL_PROFILE at run time then turns it on.
+#ifndef TRIANGLES_GL_PROFILE
+    #define TRIANGLES_GL_PROFILE 0
+#endif
+
+namespace gl {
+    // Source location of one glRUN expansion.
+    struct CallSite {
+        int line;
+        const char *file;
+        const char *func;
+    };
+
+    constexpr size_t MAX_TRACE_EVENTS = size_t{1} << 20;
+
+    // Call counts and CPU time of GL calls, per call site and per frame. Calls are recorded from
+    // the context thread only. With TRIANGLES_GL_PROFILE=table the totals are printed as a table,
+    // any other value names the file a Chrome trace (chrome://tracing, Perfetto) is written to.
+    class CallProfiler final {
+    public:
+        using Clock = std::chrono::steady_clock;
+
+        static CallProfiler &Get() {
+            static CallProfiler profiler;
+            return profiler;
+        }
+
+        bool IsEnabled() const {
+            return enabled_;
+        }
+
+        void Record(const CallSite &site, Clock::time_point start, Clock::time_point end) {
+            auto &stats = frame_[&site];
+            ++stats.count;
+            stats.ns += GetNs(start, end);
+
+            if (!trace_path_.empty() && events_.size() < MAX_TRACE_EVENTS)
+                events_.push_back({&site, start, end});
+        }
+
+        // Closes the current frame: its per-site numbers are folded into the totals.
+        void EndFrame() {
+            if (!enabled_)
+                return;
+
+            auto now = Clock::now();
+            for (const auto &[site, stats] : frame_) {
+                auto &total = totals_[site];
+                total.count += stats.count;
+                total.ns += stats.ns;
+                total.max_frame_ns = std::max(total.max_frame_ns, stats.ns);
+                total.max_frame_count = std::max(total.max_frame_count, stats.count);
+            }
+            frame_.clear();
+
+            if (!trace_path_.empty() && frames_.size() < MAX_TRACE_EVENTS)
+                frames_.push_back({frame_start_, now});
+            frame_start_ = now;
+            ++frame_count_;
+        }
+
+        void WriteTable(std::ostream &out) const {
+            std::vector<std::pair<const CallSite *, Totals>> rows(totals_.begin(), totals_.end());
+            std::sort(rows.begin(), rows.end(), [](const auto &lhs, const auto &rhs) {
+                return lhs.second.ns > rhs.second.ns;
+            });
+
+            uint64_t total_ns = 0;
+            for (const auto &[site, total] : rows)
+                total_ns += total.ns;
+
+            size_t frames = std::max<size_t>(frame_count_, 1);
+            out << std::format("GL calls over {} frames, {:.3f} ms in total\n", frame_count_, total_ns * 1e-6);
+            out << std::format("{:<28} | {:<28} | {:>9} | {:>11} | {:>9} | {:>9} | {:>12} | {:>6}\n", "function", "site",
+                               "calls", "calls/frame", "total ms", "us/frame", "max us/frame", "share");
+            for (const auto &[site, total] : rows)
+                out << std::format("{:<28} | {:<28} | {:>9} | {:>11.1f} | {:>9.3f} | {:>9.2f} | {:>12.2f} | {:>5.1f}%\n",
+                                   site->func, GetSiteName(*site), total.count, double(total.count) / frames, total.ns * 1e-6,
+                                   total.ns * 1e-3 / frames, total.max_frame_ns * 1e-3,
+                                   total_ns ? 100.0 * total.ns / total_ns : 0.0);
+        }
+
+        // Chrome trace event format: GL calls on one track, frames on another, times in microseconds.
+        void WriteTrace(std::ostream &out) const {
+            auto to_us = [this](Clock::time_point point) { return GetNs(origin_, point) * 1e-3; };
+
+            out << "{\"displayTimeUnit\": \"ms\", \"traceEvents\": [\n";
+            out << R"({"name": "thread_name", "ph": "M", "pid": 0, "tid": 0, "args": {"name": "GL calls"}},)" << '\n';
+            out << R"({"name": "thread_name", "ph": "M", "pid": 0, "tid": 1, "args": {"name": "frames"}})";
+            for (size_t i = 0; i < frames_.size(); ++i)
+                out << std::format(",\n{{\"name\": \"frame {}\", \"cat\": \"frame\", \"ph\": \"X\", \"pid\": 0, \"tid\": 1, "
+                                   "\"ts\": {:.3f}, \"dur\": {:.3f}}}",
+                                   i, to_us(frames_[i].start), GetNs(frames_[i].start, frames_[i].end) * 1e-3);
+            for (const auto &event : events_)
+                out << std::format(",\n{{\"name\": \"{}\", \"cat\": \"gl\", \"ph\": \"X\", \"pid\": 0, \"tid\": 0, "
+                                   "\"ts\": {:.3f}, \"dur\": {:.3f}, \"args\": {{\"site\": \"{}\"}}}}",
+                                   event.site->func, to_us(event.start), GetNs(event.start, event.end) * 1e-3,
+                                   GetSiteName(*event.site));
+            out << "\n]}\n";
+        }
+
+        // Writes the report the environment asked for; a no-op when profiling is off.
+        void Dump(std::ostream &table_out) const {
+            if (!enabled_)
+                return;
+
+            if (trace_path_.empty()) {
+                WriteTable(table_out);
+                return;
+            }
+
+            std::ofstream out{trace_path_};
+            WriteTrace(out);
+            if (!out.good())
+                table_out << std::format("Failed to write the GL trace to '{}'\n", trace_path_);
+        }
+
+    private:
+        struct FrameStats {
+            uint64_t count = 0;
+            uint64_t ns = 0;
+        };
+
+        struct Totals {
+            uint64_t count = 0;
+            uint64_t ns = 0;
+            uint64_t max_frame_ns = 0;
+            uint64_t max_frame_count = 0;
+        };
+
+        struct Event {
+            const CallSite *site;
+            Clock::time_point start;
+            Clock::time_point end;
+        };
+
+        struct Frame {
+            Clock::time_point start;
+            Clock::time_point end;
+        };
+
+        CallProfiler() : origin_(Clock::now()), frame_start_(origin_) {
+            if (!TRIANGLES_GL_PROFILE)
+                return;
+
+            if (const char *env = std::getenv("TRIANGLES_GL_PROFILE")) {
+                enabled_ = true;
+                if (std::string_view{env} != "table")
+                    trace_path_ = env;
+            }
+        }
+
+        static uint64_t GetNs(Clock::time_point start, Clock::time_point end) {
+            return static_cast<uint64_t>(std::chrono::duration_cast<std::chrono::nanoseconds>(end - start).count());
+        }
+
+        // Only the file name, the directories make the table too wide.
+        static std::string GetSiteName(const CallSite &site) {
+            std::string_view file = site.file;
+            if (auto slash = file.find_last_of("/\\"); slash != std::string_view::npos)
+                file.remove_prefix(slash + 1);
+            return std::format("{}:{}", file, site.line);
+        }
+
+        bool enabled_ = false;
+        std::string trace_path_;
+        Clock::time_point origin_;
+        Clock::time_point frame_start_;
+        size_t frame_count_ = 0;
+        std::unordered_map<const CallSite *, FrameStats> frame_;
+        std::unordered_map<const CallSite *, Totals> totals_;
+        std::vector<Event> events_;
+        std::vector<Frame> frames_;
+    }; // class CallProfiler
+} // namespace gl
@@ -0,0 +1,150 @@
+#pragma once
+
+#include "GL/gl.hpp"
+#include "utility.hpp"
+
+#include <algorithm>
+#include <array>
+#include <cstdint>
+#include <filesystem>
+#include <format>
+#include <fstream>
+#include <random>
+#include <string>
+#include <string_view>
+#include <vector>
+
+namespace gl {
+    // Source text of one stage of a program.
+    struct ShaderSource {
+        int type;
+        std::string text;
+    };
+
+    constexpr uint64_t PROGRAM_HASH_BASIS = 0xCBF29CE484222325ULL; // 64-bit FNV-1a
+    constexpr uint64_t PROGRAM_HASH_PRIME = 0x100000001B3ULL;
+    constexpr size_t MAX_PROGRAM_BINARY_SIZE = size_t{64} << 20; // larger sizes only come from damaged entries
+
+    // On-disk store of linked program binaries. An entry is keyed by the shader sources and the
+    // vendor, renderer and version strings of the driver. A driver may still reject a binary, for one
+    // after an update that kept those strings, so a failed Load means compiling from the sources.
+    class ProgramCache final {
+    public:
+        explicit ProgramCache(std::filesystem::path dir = file::GetCacheDir() / "programs") : dir_(std::move(dir)) {}
+
+        static ProgramCache &Get() {
+            static ProgramCache cache;
+            return cache;
+        }
+
+        // Binaries come with GL 4.1 or ARB_get_program_binary, and not every driver offers a format.
+        static bool IsSupported() {
+            if (!GLAD_GL_VERSION_4_1 && !GLAD_GL_ARB_get_program_binary)
+                return false;
+
+            GLint count = 0;
+            glRUN(glGetIntegerv, GL_NUM_PROGRAM_BINARY_FORMATS, &count);
+            return count > 0;
+        }
+
+        static uint64_t GetKey(const std::vector<ShaderSource> &sources) {
+            uint64_t hash = PROGRAM_HASH_BASIS;
+            auto add = [&](std::string_view text) {
+                for (unsigned char c : text)
+                    hash = (hash ^ c) * PROGRAM_HASH_PRIME;
+                hash = (hash ^ 0xFFU) * PROGRAM_HASH_PRIME; // never in text, ends every part
+            };
+
+            for (GLenum name : {GL_VENDOR, GL_RENDERER, GL_VERSION, GL_SHADING_LANGUAGE_VERSION}) {
+                auto *string = reinterpret_cast<const char *>(glRUN(glGetString, name));
+                add(string ? string : "");
+            }
+            for (const auto &source : sources) {
+                add(std::to_string(source.type));
+                add(source.text);
+            }
+            return hash;
+        }
+
+        // Gives 'program' the stored binary; true when the driver accepted it and linked the program.
+        bool Load(uint64_t key, GLuint program) const {
+            std::ifstream in{GetPath(key), std::ios::binary};
+            if (!in.is_open())
+                return false;
+
+            Header header{};
+            if (!in.read(reinterpret_cast<char *>(&header), sizeof(Header)) || header.magic != MAGIC || header.key != key ||
+                header.size > MAX_PROGRAM_BINARY_SIZE || !IsFormatSupported(header.format))
+                return false;
+
+            std::vector<char> binary(header.size);
+            if (!in.read(binary.data(), static_cast<std::streamsize>(binary.size())))
+                return false;
+
+            glRUN(glProgramBinary, program, header.format, binary.data(), static_cast<GLsizei>(binary.size()));
+            GLint success = 0;
+            glRUN(glGetProgramiv, program, GL_LINK_STATUS, &success);
+            return success;
+        }
+
+        // Writes through a temporary file and a rename, so a concurrent reader never sees half an entry.
+        void Store(uint64_t key, GLuint program) const {
+            GLint length = 0;
+            glRUN(glGetProgramiv, program, GL_PROGRAM_BINARY_LENGTH, &length);
+            if (length <= 0)
+                return;
+
+            Header header{MAGIC, 0U, static_cast<uint32_t>(length), key};
+            std::vector<char> binary(static_cast<size_t>(length));
+            glRUN(glGetProgramBinary, program, length, nullptr, &header.format, binary.data());
+
+            std::error_code error;
+            std::filesystem::create_directories(dir_, error);
+            if (error)
+                return;
+
+            auto path = GetPath(key);
+            auto tmp = path;
+            tmp += std::format(".{}.tmp", std::random_device{}());
+            {
+                std::ofstream out{tmp, std::ios::binary};
+                out.write(reinterpret_cast<const char *>(&header), sizeof(Header));
+                out.write(binary.data(), static_cast<std::streamsize>(binary.size()));
+                if (!out.good()) {
+                    out.close();
+                    std::filesystem::remove(tmp, error);
+                    return;
+                }
+            }
+
+            std::filesystem::rename(tmp, path, error);
+            if (error)
+                std::filesystem::remove(tmp, error);
+        }
+
+    private:
+        static constexpr std::array<char, 8> MAGIC = {'T', 'R', 'I', 'P', 'R', 'O', 'G', '1'};
+
+        struct Header {
+            std::array<char, 8> magic;
+            GLenum format;
+            uint32_t size;
+            uint64_t key;
+        };
+
+        static bool IsFormatSupported(GLenum format) {
+            GLint count = 0;
+            glRUN(glGetIntegerv, GL_NUM_PROGRAM_BINARY_FORMATS, &count);
+            std::vector<GLint> formats(static_cast<size_t>(std::max(count, 0)));
+            if (!formats.empty())
+                glRUN(glGetIntegerv, GL_PROGRAM_BINARY_FORMATS, formats.data());
+            return std::find(formats.begin(), formats.end(), static_cast<GLint>(format)) != formats.end();
+        }
+
+        std::filesystem::path GetPath(uint64_t key) const {
+            return dir_ / std::format("{:016x}.bin", key);
+        }
+
+        std::filesystem::path dir_;
+    }; // class ProgramCache
+} // namespace gl
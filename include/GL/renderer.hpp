@@ -2,9 +2,16 @@
 
 #include "GL/gl.hpp"
 #include "GL/camera.hpp"
+#include "GL/frustum.hpp"
+#include "GL/program_cache.hpp"
+#include "GL/uniform.hpp"
 #include "utility.hpp"
 
+#include <memory>
+#include <string>
 #include <type_traits>
+#include <unordered_map>
+#include <vector>
 
 namespace gl {
     namespace details {
@@ -15,7 +22,97 @@ namespace gl {
         struct is_pointer_like<T, std::void_t<decltype(*std::declval<T&>())>> : std::true_type {};
     } // namespace details
 
-    constexpr size_t MAX_COUNT_ATTACHED_SHADERS = 2U;
+    class Shader final : public IShader {
+    public:
+        Shader(int type) try : type_(type) {
+            shader_ = glRUN(glCreateShader, type_);
+        } catch (std::exception &ex) {
+            glRUN(glDeleteShader, shader_);
+            throw ex;
+        }
+        
+        ~Shader() {
+            glRUN(glDeleteShader, shader_);
+        }
+
+        Shader(const Shader &other) try : type_(other.type_) {
+            shader_ = glRUN(glCreateShader, type_);
+        } catch (std::exception &ex) {
+            glRUN(glDeleteShader, shader_);
+            throw ex;
+        }
+
+        Shader &operator=(const Shader &other) {
+            if (this != &other) {
+                Shader tmp = other;
+                std::swap(*this, tmp);
+            }
+
+            return *this;
+        }
+
+        Shader(Shader &&other) noexcept : type_(std::move(other.type_)) {
+            std::swap(shader_, other.shader_);
+        }
+
+        Shader &operator=(Shader &&other) noexcept {
+            if (this != &other) {
+                std::swap(shader_, other.shader_);
+                std::swap(type_, other.type_);
+            }
+
+            return *this;
+        }
+        
+        int Use() const override {
+            return shader_;
+        }
+        
+        void Compile(std::string_view file_name) override {
+            StartCompile(file::ReadFile(file_name));
+            CheckCompiled();
+        }
+
+        // Only hands the source to the driver, which may compile it in the background.
+        void StartCompile(const std::string &source) {
+            const char *text = source.data();
+            glShaderSource(shader_, 1, &text, NULL);
+            glRUN(glCompileShader, shader_);
+        }
+
+        void CheckCompiled() const {
+            int success;
+            glRUN(glGetShaderiv, shader_, GL_COMPILE_STATUS, &success);
+            if (!success) {
+                throw glException("Failed to compile shader");
+            }
+        }
+        
+    private:
+        int shader_ = 0;
+        int type_ = 0;
+    }; // class Shader
+
+    // Stage and file of one shader of a program.
+    struct ShaderFile {
+        int type;
+        std::string path;
+    };
+
+    namespace details {
+        // Lets the driver compile and link on as many threads as it likes, once per process.
+        inline void EnableParallelCompile() {
+            static bool enabled = [] {
+                if (GLAD_GL_KHR_parallel_shader_compile)
+                    glRUN(glMaxShaderCompilerThreadsKHR, 0xFFFFFFFFU);
+                else if (GLAD_GL_ARB_parallel_shader_compile)
+                    glRUN(glMaxShaderCompilerThreadsARB, 0xFFFFFFFFU);
+                return true;
+            }();
+            (void)enabled;
+        }
+    } // namespace details
+
     class Program final {
     public:
         Program() try {
@@ -48,16 +145,71 @@ namespace gl {
 
         Program(Program &&other) noexcept {
             std::swap(id_, other.id_);
+            std::swap(uniforms_, other.uniforms_);
+            std::swap(pending_, other.pending_);
         }
 
         Program &operator=(Program &&other) noexcept {
             if (this != &other) {
                 std::swap(id_, other.id_);
+                std::swap(uniforms_, other.uniforms_);
+                std::swap(pending_, other.pending_);
             }
 
             return *this;
         }
 
+        // Links the program from 'files', or loads it from the binary cache when an earlier run stored
+        // it. With 'deferred' the link is only waited for at the first use, so a driver with parallel
+        // shader compilation builds programs that are not needed at once in the background.
+        void Build(const std::vector<ShaderFile> &files, bool deferred = false) {
+            std::vector<ShaderSource> sources;
+            for (const auto &file : files)
+                sources.push_back({file.type, file::ReadFile(file.path)});
+
+            bool cached = ProgramCache::IsSupported();
+            uint64_t key = cached ? ProgramCache::GetKey(sources) : 0U;
+            if (cached && ProgramCache::Get().Load(key, id_)) {
+                ResolveUniforms();
+                return;
+            }
+
+            details::EnableParallelCompile();
+            pending_ = std::make_unique<PendingLink>(PendingLink{key, cached, {}});
+            pending_->shaders.reserve(sources.size());
+            for (const auto &source : sources) {
+                auto &shader = pending_->shaders.emplace_back(source.type);
+                shader.StartCompile(source.text);
+                AttachShader(shader);
+            }
+
+            if (cached)
+                glRUN(glProgramParameteri, id_, GL_PROGRAM_BINARY_RETRIEVABLE_HINT, GL_TRUE);
+            glRUN(glLinkProgram, id_);
+            if (!deferred)
+                Complete();
+        }
+
+        // Waits for the link Build started, checks it and stores the binary.
+        void Complete() {
+            if (!pending_)
+                return;
+
+            auto pending = std::move(pending_);
+            int success;
+            glRUN(glGetProgramiv, id_, GL_LINK_STATUS, &success);
+            if (!success) {
+                for (const auto &shader : pending->shaders)
+                    shader.CheckCompiled();
+                throw glException("Program linking is failed");
+            }
+
+            DetachShaders();
+            ResolveUniforms();
+            if (pending->store)
+                ProgramCache::Get().Store(pending->key, id_);
+        }
+
         void AttachShader(const IShader& shader_obj) {
             glRUN(glAttachShader, id_, shader_obj.Use());
         }
@@ -69,114 +221,97 @@ namespace gl {
             if (!success) {
                 throw glException("Program linking is failed");
             }
+
+            ResolveUniforms();
         }
 
         void Run() {
+            Complete();
             glRUN(glUseProgram, id_);
         }
-        
-        int operator()() const {
-            return id_;
+
+        // Location resolved at link time, -1 for names that are not active uniforms outside blocks.
+        int GetUniformLocation(const std::string &name) const {
+            auto it = uniforms_.find(name);
+            return (it != uniforms_.end()) ? it->second : -1;
         }
-    private:
-        void DetachShaders() const {
-            std::vector<GLuint> attached_shaders{MAX_COUNT_ATTACHED_SHADERS};
-            int count = 0;
-            glRUN(glGetAttachedShaders, id_, MAX_COUNT_ATTACHED_SHADERS, &count, attached_shaders.data());
-            for (int i = 0; i < count; ++i)
-                glRUN(glDetachShader, id_, attached_shaders[i]);
+
+        template <typename T>
+        void SetUniform(const std::string &name, const T &value) const {
+            gl::SetUniform(GetUniformLocation(name), value);
         }
-        int id_;
-    }; // class Program
 
-    class Shader final : public IShader {
-    public:
-        Shader(int type) try : type_(type) {
-            shader_ = glRUN(glCreateShader, type_);
-        } catch (std::exception &ex) {
-            glRUN(glDeleteShader, shader_);
-            throw ex;
+        void BindUniformBlock(std::string_view name, unsigned int binding) {
+            Complete();
+            auto index = glRUN(glGetUniformBlockIndex, id_, name.data());
+            if (index == GL_INVALID_INDEX)
+                throw glException(std::format("Uniform block '{}' is not found", name));
+            glRUN(glUniformBlockBinding, id_, index, binding);
         }
         
-        ~Shader() {
-            glRUN(glDeleteShader, shader_);
-        }
-
-        Shader(const Shader &other) try : type_(other.type_) {
-            shader_ = glRUN(glCreateShader, type_);
-        } catch (std::exception &ex) {
-            glRUN(glDeleteShader, shader_);
-            throw ex;
+        int operator()() const {
+            return id_;
         }
+    private:
+        void ResolveUniforms() {
+            uniforms_.clear();
 
-        Shader &operator=(const Shader &other) {
-            if (this != &other) {
-                Shader tmp = other;
-                std::swap(*this, tmp);
-            }
+            int count = 0, max_length = 0;
+            glRUN(glGetProgramiv, id_, GL_ACTIVE_UNIFORMS, &count);
+            glRUN(glGetProgramiv, id_, GL_ACTIVE_UNIFORM_MAX_LENGTH, &max_length);
 
-            return *this;
-        }
+            std::string name(static_cast<size_t>(max_length), '\0');
+            for (int i = 0; i < count; ++i) {
+                GLsizei length = 0;
+                GLint size = 0;
+                GLenum type = 0;
+                glRUN(glGetActiveUniform, id_, i, max_length, &length, &size, &type, name.data());
 
-        Shader(Shader &&other) noexcept : type_(std::move(other.type_)) {
-            std::swap(shader_, other.shader_);
+                std::string uniform = name.substr(0, length);
+                int location = glRUN(glGetUniformLocation, id_, uniform.c_str());
+                if (location >= 0)
+                    uniforms_.emplace(std::move(uniform), location);
+            }
         }
 
-        Shader &operator=(Shader &&other) noexcept {
-            if (this != &other) {
-                std::swap(shader_, other.shader_);
-                std::swap(type_, other.type_);
-            }
+        void DetachShaders() const {
+            int count = 0;
+            glRUN(glGetProgramiv, id_, GL_ATTACHED_SHADERS, &count);
+            if (count <= 0)
+                return;
 
-            return *this;
-        }
-        
-        int Use() const override {
-            return shader_;
+            std::vector<GLuint> attached_shaders(static_cast<size_t>(count));
+            glRUN(glGetAttachedShaders, id_, count, &count, attached_shaders.data());
+            for (int i = 0; i < count; ++i)
+                glRUN(glDetachShader, id_, attached_shaders[i]);
         }
-        
-        void Compile(std::string_view file_name) override {
-            std::ifstream stream(file_name.data());
-            if (!stream.is_open()) {
-                throw std::runtime_error("Shader file is not found");
-            }
 
-            std::string program_text = std::string(std::istreambuf_iterator<char>(stream), std::istreambuf_iterator<char>());
-            const char *text = program_text.data();
+        // Shaders of a link that may still run, kept for their logs.
+        struct PendingLink {
+            uint64_t key;
+            bool store;
+            std::vector<Shader> shaders;
+        };
 
-            glShaderSource(shader_, 1, &text, NULL);
-            glRUN(glCompileShader, shader_);
+        int id_;
+        std::unordered_map<std::string, int> uniforms_;
+        std::unique_ptr<PendingLink> pending_;
+    }; // class Program
 
-            int success;
-            glRUN(glGetShaderiv, shader_, GL_COMPILE_STATUS, &success);
-            if (!success) {
-                throw glException("Failed to compile shader");
-            }
-        }
-        
-    private:
-        int shader_ = 0;
-        int type_ = 0;
-    }; // class Shader
-    
     class Renderer final {
     public:
-        Renderer() : program_() {
+        Renderer() : program_(), frame_uniforms_(sizeof(FrameUniforms), FRAME_UNIFORMS_BINDING) {
             glEnable(GL_DEPTH_TEST);
             glDepthFunc(GL_LESS);
 
-            auto &&vs = file::FindFile("shaders", ".vs");
-            auto &&fs = file::FindFile("shaders", ".fs");
-            
-            gl::Shader vertex{GL_VERTEX_SHADER};
-            gl::Shader fragment{GL_FRAGMENT_SHADER};
-            
-            vertex.Compile(vs.front());
-            fragment.Compile(fs.front());
-    
-            program_.AttachShader(vertex);
-            program_.AttachShader(fragment);
-            program_.Link();
+            program_.Build({{GL_VERTEX_SHADER, file::FindFile("shaders", ".vs").front()},
+                            {GL_FRAGMENT_SHADER, file::FindFile("shaders", ".fs").front()}});
+            program_.BindUniformBlock("FrameUniforms", FRAME_UNIFORMS_BINDING);
+
+            // Samples off the pixel centers would defeat the small geometry culling.
+            GLint samples = 0;
+            glRUN(glGetIntegerv, GL_SAMPLES, &samples);
+            single_sample_ = samples <= 1;
         }
         
         template <typename SceneIterator>
@@ -188,27 +323,33 @@ namespace gl {
 
             glRUN(glClearColor, 0.4f, 0.4f, 0.4f, 1.0f);
             glRUN(glClear, GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
-    
+
+            // One upload for all per-frame values instead of a lookup and a call per uniform.
+            FrameUniforms frame{camera.GetProjectionMatrix(), camera.GetViewMatrix(),
+                                glm::vec4{camera.GetTarget(), 1.0f}, glm::vec4{1.0f, 1.0f, 1.0f, 1.0f}};
+            frame_uniforms_.Push(frame);
+
+            GLint viewport[4];
+            glRUN(glGetIntegerv, GL_VIEWPORT, viewport);
+            Frustum frustum = GetFrustum(frame.projection * frame.view);
+            frustum.pixel_scale = 0.5f * frame.projection[1][1] * static_cast<float>(viewport[3]);
+            if (single_sample_)
+                frustum.viewport = {static_cast<float>(viewport[2]), static_cast<float>(viewport[3])};
+            for (auto it = begin; it != end; ++it) {
+                (*it)->Cull(frustum);
+            }
+
             program_.Run();
-        
-            glm::mat4 projection = camera.GetProjectionMatrix();
-            glm::mat4 view = camera.GetViewMatrix();
-            
-            glm::vec3 lightPos = camera.GetTarget();
-            glm::vec3 lightColor = glm::vec3{1.0f, 1.0f, 1.0f};
-
-            SetUniform(program_(), "projection", projection);
-            SetUniform(program_(), "view", view);
-
-            SetUniform(program_(), "lightPos", lightPos);
-            SetUniform(program_(), "lightColor", lightColor);
-            
             for (auto it = begin; it != end; ++it) {
                 (*it)->Draw();
             }
+
+            frame_uniforms_.Fence();
         }
 
     private:
         Program program_;
+        UniformRing frame_uniforms_;
+        bool single_sample_ = true;
     }; // class Renderer
 } // namespace gl
\ No newline at end of file
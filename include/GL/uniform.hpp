@@ -0,0 +1,125 @@
+#pragma once
+
+#include "GL/gl.hpp"
+
+#include <algorithm>
+#include <array>
+#include <cstring>
+#include <stdexcept>
+
+namespace gl {
+    // Per-frame shader inputs, laid out by the std140 rules of the 'FrameUniforms' block.
+    struct FrameUniforms {
+        glm::mat4 projection;
+        glm::mat4 view;
+        glm::vec4 light_pos;   // xyz used
+        glm::vec4 light_color; // xyz used
+    };
+
+    constexpr unsigned int FRAME_UNIFORMS_BINDING = 0U;
+    constexpr size_t UNIFORM_RING_SIZE = 3U; // frames the GPU may lag behind before a write waits
+    constexpr GLuint64 FENCE_TIMEOUT_NS = 1000000U;
+
+    // Uniform buffer split into UNIFORM_RING_SIZE slots, one per frame in flight. With buffer storage
+    // (GL 4.4 or ARB_buffer_storage) the buffer is mapped once, persistently, and a slot is written
+    // directly after the fence of the frame that last used it has passed. Without it, the slot is
+    // updated with glBufferSubData; the other frames in flight still read untouched slots.
+    class UniformRing final {
+    public:
+        UniformRing(size_t size, unsigned int binding) : binding_(binding) {
+            GLint alignment = 0;
+            glRUN(glGetIntegerv, GL_UNIFORM_BUFFER_OFFSET_ALIGNMENT, &alignment);
+            alignment = std::max(alignment, 1);
+            stride_ = (size + alignment - 1) / alignment * alignment;
+            size_ = size;
+
+            glRUN(glGenBuffers, 1, &UBO_);
+            glRUN(glBindBuffer, GL_UNIFORM_BUFFER, UBO_);
+            GLsizeiptr total = static_cast<GLsizeiptr>(stride_ * UNIFORM_RING_SIZE);
+            if (GLAD_GL_VERSION_4_4 || GLAD_GL_ARB_buffer_storage) {
+                GLbitfield flags = GL_MAP_WRITE_BIT | GL_MAP_PERSISTENT_BIT | GL_MAP_COHERENT_BIT;
+                glRUN(glBufferStorage, GL_UNIFORM_BUFFER, total, nullptr, flags);
+                mapped_ = static_cast<unsigned char *>(glRUN(glMapBufferRange, GL_UNIFORM_BUFFER, 0, total, flags));
+                if (mapped_ == nullptr) {
+                    glRUN(glDeleteBuffers, 1, &UBO_);
+                    throw glException("Failed to map the uniform ring");
+                }
+            } else {
+                glRUN(glBufferData, GL_UNIFORM_BUFFER, total, nullptr, GL_DYNAMIC_DRAW);
+            }
+            glRUN(glBindBuffer, GL_UNIFORM_BUFFER, 0);
+        }
+
+        UniformRing(const UniformRing &other) = delete;
+        UniformRing &operator=(const UniformRing &other) = delete;
+
+        ~UniformRing() {
+            for (auto fence : fences_)
+                if (fence)
+                    glDeleteSync(fence);
+            if (mapped_) {
+                glBindBuffer(GL_UNIFORM_BUFFER, UBO_);
+                glUnmapBuffer(GL_UNIFORM_BUFFER);
+                glBindBuffer(GL_UNIFORM_BUFFER, 0);
+            }
+            glDeleteBuffers(1, &UBO_);
+        }
+
+        // Writes the next slot and binds it to the binding point for the coming draws.
+        void Push(const void *data, size_t size) {
+            if (size > size_)
+                throw std::out_of_range("Uniform data is bigger than a ring slot");
+
+            slot_ = (slot_ + 1) % UNIFORM_RING_SIZE;
+            size_t offset = slot_ * stride_;
+            if (mapped_) {
+                Wait(fences_[slot_]);
+                std::memcpy(mapped_ + offset, data, size);
+            } else {
+                glRUN(glBindBuffer, GL_UNIFORM_BUFFER, UBO_);
+                glRUN(glBufferSubData, GL_UNIFORM_BUFFER, offset, size, data);
+                glRUN(glBindBuffer, GL_UNIFORM_BUFFER, 0);
+            }
+
+            glRUN(glBindBufferRange, GL_UNIFORM_BUFFER, binding_, UBO_, offset, size_);
+        }
+
+        template <typename T>
+        void Push(const T &data) {
+            Push(&data, sizeof(T));
+        }
+
+        // Marks the end of the draws reading the current slot.
+        void Fence() {
+            if (!mapped_)
+                return;
+
+            if (fences_[slot_])
+                glRUN(glDeleteSync, fences_[slot_]);
+            fences_[slot_] = glRUN(glFenceSync, GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+        }
+
+    private:
+        static void Wait(GLsync &fence) {
+            if (!fence)
+                return;
+
+            GLenum status = GL_TIMEOUT_EXPIRED;
+            while (status == GL_TIMEOUT_EXPIRED)
+                status = glRUN(glClientWaitSync, fence, GL_SYNC_FLUSH_COMMANDS_BIT, FENCE_TIMEOUT_NS);
+            if (status == GL_WAIT_FAILED)
+                throw glException("Waiting for a uniform ring fence failed");
+
+            glRUN(glDeleteSync, fence);
+            fence = nullptr;
+        }
+
+        unsigned int UBO_ = 0;
+        unsigned int binding_ = 0;
+        size_t size_ = 0;
+        size_t stride_ = 0;
+        size_t slot_ = 0;
+        unsigned char *mapped_ = nullptr;
+        std::array<GLsync, UNIFORM_RING_SIZE> fences_{};
+    }; // class UniformRing
+} // namespace gl
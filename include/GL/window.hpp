@@ -21,6 +21,7 @@ namespace gl {
                 glfwTerminate();
                 throw glException("Failed to initialize GLAD");
             }
+            InitErrorChecking();
 
             try {
                 SetCallbacks();
@@ -54,12 +55,21 @@ namespace gl {
         
         template <typename SceneIterator>
         void DrawFrames(SceneIterator begin, SceneIterator end, Renderer &renderer, Camera &camera) const {
+            DrawFrames(begin, end, renderer, camera, [] {});
+        }
+
+        // 'on_frame' runs before every frame, e.g. to feed the meshes with fresh data.
+        template <typename SceneIterator, typename FrameFuncT>
+        void DrawFrames(SceneIterator begin, SceneIterator end, Renderer &renderer, Camera &camera, FrameFuncT &&on_frame) const {
             while (!IsShouldBeClosed()) {
                 handler_->UpdateEvent();
+                on_frame();
                 
                 renderer.Render(begin, end, camera);
                 glRUN(glfwSwapBuffers, window_);
                 glRUN(glfwPollEvents);
+                CheckPendingError();
+                CallProfiler::Get().EndFrame();
             }
         }
         
@@ -0,0 +1,204 @@
+#pragma once
+
+#include "intersection/narrow.hpp"
+#include "intersection/triangle.hpp"
+#include "parallel.hpp"
+
+#include <bit>
+#include <cstdint>
+#include <numeric>
+#include <vector>
+
+namespace intersection {
+    // Vertex welding of a triangle soup: corners at bit-identical positions get one vertex id,
+    // so triangles of a mesh that share an edge or a vertex can be recognized.
+    struct MeshTopology {
+        std::vector<uint32_t> corners; // vertex id of corner k of triangle t at 3 * t + k
+        size_t vertex_count = 0;
+    };
+
+    // Corners two triangles have in common: lhs[k] of the first triangle is rhs[k] of the second.
+    struct SharedCorners {
+        int count = 0;
+        int lhs[3] = {};
+        int rhs[3] = {};
+    };
+
+    namespace details {
+        inline uint32_t GetBits(float value) {
+            return std::bit_cast<uint32_t>(value == 0.0f ? 0.0f : value); // -0 and +0 are one position
+        }
+
+        inline uint64_t GetPositionKey(const glm::vec3 &point) {
+            uint64_t key = (uint64_t{GetBits(point.x)} << 32) | GetBits(point.y);
+            key ^= uint64_t{GetBits(point.z)} * 0x9E3779B97F4A7C15ULL;
+            key ^= key >> 29;
+            return key * 0xBF58476D1CE4E5B9ULL;
+        }
+
+        inline bool IsSamePosition(const glm::vec3 &lhs, const glm::vec3 &rhs) {
+            return GetBits(lhs.x) == GetBits(rhs.x) && GetBits(lhs.y) == GetBits(rhs.y) && GetBits(lhs.z) == GetBits(rhs.z);
+        }
+
+        inline const glm::vec3 &GetCorner(const Triangle &tri, int k) {
+            return (k == 0) ? tri.a : (k == 1) ? tri.b : tri.c;
+        }
+
+        inline int GetOtherCorner(int first, int second) {
+            return 3 - first - second;
+        }
+
+        // Whether the ray from 'apex' through 'ray' lies strictly inside the angle 'apex', 'p1', 'p2'.
+        inline bool IsInsideWedge2D(const glm::vec2 &apex, const glm::vec2 &p1, const glm::vec2 &p2, const glm::vec2 &ray) {
+            int side1 = GetSide2D(apex, p1, ray);
+            int side2 = GetSide2D(apex, p2, ray);
+            return side1 != 0 && side2 != 0 && side1 == GetSide2D(apex, p1, p2) && side2 == GetSide2D(apex, p2, p1);
+        }
+
+        inline bool IsSameRay2D(const glm::vec2 &apex, const glm::vec2 &lhs, const glm::vec2 &rhs) {
+            return GetSide2D(apex, lhs, rhs) == 0 && glm::dot(lhs - apex, rhs - apex) > 0.0f;
+        }
+
+        // Point where the triangle 'apex', 'p1', 'p2' leaves the plane it touches at 'apex', given the
+        // snapped distances of 'p1' and 'p2' to that plane. Returns false if it only touches at 'apex'.
+        inline bool GetPlaneExit(const glm::vec3 &p1, float d1, const glm::vec3 &p2, float d2, glm::vec3 &exit) {
+            if (d1 * d2 < 0.0f)
+                exit = p1 + (p2 - p1) * (d1 / (d1 - d2));
+            else if (d1 == 0.0f)
+                exit = p1;
+            else if (d2 == 0.0f)
+                exit = p2;
+            else
+                return false;
+            return true;
+        }
+    } // namespace details
+
+    inline MeshTopology BuildTopology(const std::vector<glm::vec3> &points) {
+        size_t corner_count = points.size();
+        std::vector<uint64_t> keys(corner_count);
+        parallel::For(corner_count, parallel::DEFAULT_GRAIN * 16, [&](size_t begin, size_t end, size_t) {
+            for (size_t i = begin; i < end; ++i)
+                keys[i] = details::GetPositionKey(points[i]);
+        });
+
+        std::vector<uint32_t> ids(corner_count);
+        std::iota(ids.begin(), ids.end(), 0U);
+        parallel::SortByKey(keys, ids);
+
+        // Equal keys almost always mean equal positions; a collision just splits the run further.
+        MeshTopology topology;
+        topology.corners.resize(corner_count);
+        for (size_t begin = 0; begin < corner_count;) {
+            size_t end = begin + 1;
+            while (end < corner_count && keys[end] == keys[begin])
+                ++end;
+
+            for (size_t k = begin; k < end; ++k) {
+                size_t first = begin;
+                while (first < k && !details::IsSamePosition(points[ids[first]], points[ids[k]]))
+                    ++first;
+                topology.corners[ids[k]] = (first == k) ? static_cast<uint32_t>(topology.vertex_count++)
+                                                        : topology.corners[ids[first]];
+            }
+            begin = end;
+        }
+
+        return topology;
+    }
+
+    // Every corner is matched at most once, so figures with repeated corners never yield more than
+    // three shared pairs.
+    inline SharedCorners GetSharedCorners(const MeshTopology &topology, size_t lhs, size_t rhs) {
+        SharedCorners shared;
+        bool used[3] = {};
+        for (int k = 0; k < 3 && shared.count < 3; ++k)
+            for (int m = 0; m < 3; ++m)
+                if (!used[m] && topology.corners[3 * lhs + k] == topology.corners[3 * rhs + m]) {
+                    used[m] = true;
+                    shared.lhs[shared.count] = k;
+                    shared.rhs[shared.count] = m;
+                    ++shared.count;
+                    break;
+                }
+
+        return shared;
+    }
+
+    // The same match on the corner positions themselves, for a single pair outside a welded scene.
+    inline SharedCorners GetSharedCorners(const Triangle &lhs, const Triangle &rhs) {
+        SharedCorners shared;
+        bool used[3] = {};
+        for (int k = 0; k < 3 && shared.count < 3; ++k)
+            for (int m = 0; m < 3; ++m)
+                if (!used[m] && details::IsSamePosition(details::GetCorner(lhs, k), details::GetCorner(rhs, m))) {
+                    used[m] = true;
+                    shared.lhs[shared.count] = k;
+                    shared.rhs[shared.count] = m;
+                    ++shared.count;
+                    break;
+                }
+
+        return shared;
+    }
+
+    // Test for triangles sharing topology, which always touch along the shared edge or at the shared
+    // vertex. Only an overlap beyond that contact counts: a fold-over of edge neighbours, triangles
+    // crossing away from their common vertex, or a duplicated face.
+    inline bool IntersectAdjacent(const Triangle &lhs, const glm::vec3 &lhs_normal, const Triangle &rhs,
+                                  const glm::vec3 &rhs_normal, const SharedCorners &shared) {
+        if (shared.count >= 3)
+            return true;
+
+        if (shared.count == 2) {
+            const glm::vec3 &u = details::GetCorner(lhs, shared.lhs[0]);
+            const glm::vec3 &v = details::GetCorner(lhs, shared.lhs[1]);
+            const glm::vec3 &p = details::GetCorner(lhs, details::GetOtherCorner(shared.lhs[0], shared.lhs[1]));
+            const glm::vec3 &q = details::GetCorner(rhs, details::GetOtherCorner(shared.rhs[0], shared.rhs[1]));
+
+            // Not coplanar: the triangles meet along the edge only.
+            if (details::Snap(glm::dot(lhs_normal, q - u)) != 0.0f)
+                return false;
+
+            int axis = details::GetDominantAxis(lhs_normal);
+            glm::vec2 u2 = details::Project(u, axis), v2 = details::Project(v, axis);
+            int p_side = details::GetSide2D(u2, v2, details::Project(p, axis));
+            return p_side != 0 && p_side == details::GetSide2D(u2, v2, details::Project(q, axis));
+        }
+
+        int lhs_apex = shared.lhs[0], rhs_apex = shared.rhs[0];
+        const glm::vec3 &s = details::GetCorner(lhs, lhs_apex);
+        const glm::vec3 &p1 = details::GetCorner(lhs, (lhs_apex + 1) % 3);
+        const glm::vec3 &p2 = details::GetCorner(lhs, (lhs_apex + 2) % 3);
+        const glm::vec3 &q1 = details::GetCorner(rhs, (rhs_apex + 1) % 3);
+        const glm::vec3 &q2 = details::GetCorner(rhs, (rhs_apex + 2) % 3);
+
+        float dp1 = details::Snap(glm::dot(rhs_normal, p1 - s)), dp2 = details::Snap(glm::dot(rhs_normal, p2 - s));
+        float dq1 = details::Snap(glm::dot(lhs_normal, q1 - s)), dq2 = details::Snap(glm::dot(lhs_normal, q2 - s));
+
+        if ((dp1 == 0.0f && dp2 == 0.0f) || (dq1 == 0.0f && dq2 == 0.0f)) {
+            // Coplanar: near the common vertex the triangles are two angles, they overlap if the angles do.
+            int axis = details::GetDominantAxis(lhs_normal);
+            glm::vec2 s2 = details::Project(s, axis);
+            glm::vec2 a1 = details::Project(p1, axis), a2 = details::Project(p2, axis);
+            glm::vec2 b1 = details::Project(q1, axis), b2 = details::Project(q2, axis);
+
+            if ((details::IsSameRay2D(s2, a1, b1) && details::IsSameRay2D(s2, a2, b2)) ||
+                (details::IsSameRay2D(s2, a1, b2) && details::IsSameRay2D(s2, a2, b1)))
+                return true;
+            return details::IsInsideWedge2D(s2, a1, a2, b1) || details::IsInsideWedge2D(s2, a1, a2, b2) ||
+                   details::IsInsideWedge2D(s2, b1, b2, a1) || details::IsInsideWedge2D(s2, b1, b2, a2);
+        }
+
+        // Otherwise both triangles cut the planes' common line in segments starting at the shared
+        // vertex; they intersect beyond it if the segments leave it in the same direction.
+        glm::vec3 lhs_exit, rhs_exit;
+        if (!details::GetPlaneExit(p1, dp1, p2, dp2, lhs_exit) || !details::GetPlaneExit(q1, dq1, q2, dq2, rhs_exit))
+            return false;
+
+        glm::vec3 lhs_dir = lhs_exit - s, rhs_dir = rhs_exit - s;
+        if (glm::length(lhs_dir) <= EPSILON || glm::length(rhs_dir) <= EPSILON)
+            return false;
+        return glm::dot(lhs_dir, rhs_dir) > 0.0f;
+    }
+} // namespace intersection
@@ -0,0 +1,70 @@
+#pragma once
+
+#include "intersection/intersector.hpp"
+#include "intersection/cache.hpp"
+#include "parallel.hpp"
+
+#include <atomic>
+#include <exception>
+#include <stdexcept>
+#include <thread>
+
+namespace intersection {
+    // Runs the intersection on a background thread. Newly marked triangles are streamed through a
+    // lock-free queue, so a consumer (the render loop) can show results while the run goes on.
+    // 'points' must outlive the object; destroying it cancels an unfinished run.
+    class AsyncIntersection final {
+    public:
+        AsyncIntersection(const std::vector<glm::vec3> &points, Options options, const ResultCache *cache = nullptr) {
+            options.cancel = &cancel_;
+            options.on_marked = [this](std::vector<uint32_t> &&batch) {
+                queue_.Push(std::move(batch));
+            };
+
+            thread_ = std::thread{[this, &points, options, cache] {
+                try {
+                    result_ = cache ? Intersect(points, options, *cache) : Intersect(points, options);
+                } catch (...) {
+                    error_ = std::current_exception();
+                }
+                done_.store(true, std::memory_order_release);
+            }};
+        }
+
+        AsyncIntersection(const AsyncIntersection &other) = delete;
+        AsyncIntersection &operator=(const AsyncIntersection &other) = delete;
+
+        ~AsyncIntersection() {
+            cancel_.store(true, std::memory_order_relaxed);
+            if (thread_.joinable())
+                thread_.join();
+        }
+
+        // Triangles marked since the previous call. A run served from the cache streams nothing,
+        // its flags only come with the final result.
+        std::vector<uint32_t> TakeMarked() {
+            return queue_.PopAll();
+        }
+
+        bool IsDone() const {
+            return done_.load(std::memory_order_acquire);
+        }
+
+        // Waits for the run and hands over its result, rethrowing a failure of the worker.
+        Result TakeResult() {
+            if (thread_.joinable())
+                thread_.join();
+            if (error_)
+                std::rethrow_exception(error_);
+            return std::move(result_);
+        }
+
+    private:
+        parallel::BatchQueue<uint32_t> queue_;
+        std::atomic<bool> cancel_{false};
+        std::atomic<bool> done_{false};
+        Result result_;
+        std::exception_ptr error_;
+        std::thread thread_;
+    }; // class AsyncIntersection
+} // namespace intersection
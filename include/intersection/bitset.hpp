@@ -0,0 +1,64 @@
+#pragma once
+
+#include <atomic>
+#include <bit>
+#include <cstdint>
+#include <vector>
+
+namespace intersection {
+    // Per-triangle result flags. Set() and Test() are atomic, so worker threads may mark
+    // triangles concurrently without a lock.
+    class Bitset final {
+    public:
+        Bitset() = default;
+
+        explicit Bitset(size_t size) : size_(size), words_((size + 63) / 64, 0U) {}
+
+        bool Test(size_t index) const {
+            auto &word = const_cast<uint64_t &>(words_[index / 64]);
+            return std::atomic_ref<uint64_t>{word}.load(std::memory_order_relaxed) & GetMask(index);
+        }
+
+        // Returns the previous value of the flag.
+        bool Set(size_t index) {
+            std::atomic_ref<uint64_t> word{words_[index / 64]};
+            return word.fetch_or(GetMask(index), std::memory_order_relaxed) & GetMask(index);
+        }
+
+        void Reset(size_t index) {
+            std::atomic_ref<uint64_t> word{words_[index / 64]};
+            word.fetch_and(~GetMask(index), std::memory_order_relaxed);
+        }
+
+        bool operator[](size_t index) const {
+            return Test(index);
+        }
+
+        size_t GetSize() const {
+            return size_;
+        }
+
+        size_t Count() const {
+            size_t count = 0;
+            for (auto word : words_)
+                count += std::popcount(word);
+            return count;
+        }
+
+        const std::vector<uint64_t> &GetWords() const {
+            return words_;
+        }
+
+        std::vector<uint64_t> &GetWords() {
+            return words_;
+        }
+
+    private:
+        static uint64_t GetMask(size_t index) {
+            return uint64_t{1} << (index % 64);
+        }
+
+        size_t size_ = 0;
+        std::vector<uint64_t> words_;
+    }; // class Bitset
+} // namespace intersection
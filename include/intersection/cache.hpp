@@ -0,0 +1,218 @@
+#pragma once
+
+#include "intersection/intersector.hpp"
+#include "parallel.hpp"
+#include "utility.hpp"
+
+#include <array>
+#include <bit>
+#include <cstdlib>
+#include <cstring>
+#include <filesystem>
+#include <format>
+#include <fstream>
+#include <optional>
+#include <random>
+
+namespace intersection {
+    namespace fs = std::filesystem;
+
+    constexpr size_t HASH_CHUNK_SIZE = size_t{1} << 20;
+    constexpr uint64_t HASH_PRIME1 = 0x9E3779B185EBCA87ULL;
+    constexpr uint64_t HASH_PRIME2 = 0xC2B2AE3D27D4EB4FULL;
+    constexpr uint64_t HASH_PRIME3 = 0x165667B19E3779F9ULL;
+
+    namespace details {
+        inline uint64_t MixHash(uint64_t acc, uint64_t word) {
+            acc ^= std::rotl(word * HASH_PRIME2, 31) * HASH_PRIME1;
+            return std::rotl(acc, 27) * HASH_PRIME1 + HASH_PRIME3;
+        }
+
+        inline uint64_t FinalizeHash(uint64_t hash) {
+            hash ^= hash >> 33;
+            hash *= HASH_PRIME2;
+            hash ^= hash >> 29;
+            hash *= HASH_PRIME3;
+            return hash ^ (hash >> 32);
+        }
+
+        inline uint64_t HashChunk(const unsigned char *data, size_t size, uint64_t seed) {
+            uint64_t acc = seed + HASH_PRIME3;
+            size_t i = 0;
+            for (; i + 8 <= size; i += 8) {
+                uint64_t word;
+                std::memcpy(&word, data + i, 8);
+                acc = MixHash(acc, word);
+            }
+
+            uint64_t tail = 0;
+            std::memcpy(&tail, data + i, size - i);
+            return FinalizeHash(MixHash(acc, tail ^ size));
+        }
+    } // namespace details
+
+    // Non-cryptographic 64-bit hash of the coordinate buffer. Fixed-size chunks are hashed in parallel
+    // and then combined in order, so the value does not depend on the thread count.
+    inline uint64_t HashPoints(const std::vector<glm::vec3> &points) {
+        auto data = reinterpret_cast<const unsigned char *>(points.data());
+        size_t size = points.size() * sizeof(glm::vec3);
+        size_t chunk_count = (size + HASH_CHUNK_SIZE - 1) / HASH_CHUNK_SIZE;
+
+        std::vector<uint64_t> chunks(chunk_count);
+        parallel::For(chunk_count, 1, [&](size_t begin, size_t end, size_t) {
+            for (size_t c = begin; c < end; ++c) {
+                size_t offset = c * HASH_CHUNK_SIZE;
+                chunks[c] = details::HashChunk(data + offset, std::min(HASH_CHUNK_SIZE, size - offset), c);
+            }
+        });
+
+        uint64_t hash = size;
+        for (auto chunk : chunks)
+            hash = details::MixHash(hash, chunk);
+        return details::FinalizeHash(hash);
+    }
+
+    // On-disk store of intersection results keyed by the scene content hash. An entry is only
+    // accepted when it was produced with the same algorithm version, precision and pair semantics.
+    // Statistics are not stored, a loaded result only says it came from the cache.
+    class ResultCache final {
+    public:
+        explicit ResultCache(fs::path dir = GetDefaultDir()) : dir_(std::move(dir)) {}
+
+        static fs::path GetDefaultDir() {
+            return file::GetCacheDir();
+        }
+
+        std::optional<Result> Load(uint64_t hash, size_t tri_count, const Options &options) const {
+            std::ifstream in{GetPath(hash), std::ios::binary};
+            if (!in.is_open())
+                return std::nullopt;
+
+            Header header{};
+            if (!ReadPod(in, header) || header != MakeHeader(hash, tri_count, options, header.has_graph, header.has_clusters))
+                return std::nullopt;
+            if (options.mode == Mode::AllPairs && (!header.has_graph || (options.label_clusters && !header.has_clusters)))
+                return std::nullopt;
+
+            Result result{Bitset{tri_count}, {}, {}, {}};
+            result.stats.from_cache = true;
+            if (!ReadVector(in, result.flags.GetWords(), result.flags.GetWords().size()))
+                return std::nullopt;
+
+            if (header.has_graph && options.mode == Mode::AllPairs) {
+                uint64_t neighbor_count = 0;
+                if (!ReadVector(in, result.graph.offsets, tri_count + 1) || !ReadPod(in, neighbor_count) ||
+                    !ReadVector(in, result.graph.neighbors, neighbor_count))
+                    return std::nullopt;
+
+                if (header.has_clusters && options.label_clusters && !ReadVector(in, result.clusters, tri_count))
+                    return std::nullopt;
+            }
+
+            return result;
+        }
+
+        // Writes through a temporary file and a rename, so a concurrent reader never sees half an entry.
+        void Store(uint64_t hash, const Result &result, const Options &options) const {
+            std::error_code error;
+            fs::create_directories(dir_, error);
+            if (error)
+                return;
+
+            bool has_graph = !result.graph.offsets.empty();
+            Header header = MakeHeader(hash, result.flags.GetSize(), options, has_graph, has_graph && !result.clusters.empty());
+
+            fs::path path = GetPath(hash);
+            fs::path tmp = path;
+            tmp += std::format(".{}.tmp", std::random_device{}());
+            {
+                std::ofstream out{tmp, std::ios::binary};
+                WritePod(out, header);
+                WriteVector(out, result.flags.GetWords());
+                if (header.has_graph) {
+                    WriteVector(out, result.graph.offsets);
+                    WritePod(out, static_cast<uint64_t>(result.graph.neighbors.size()));
+                    WriteVector(out, result.graph.neighbors);
+                }
+                if (header.has_clusters)
+                    WriteVector(out, result.clusters);
+
+                if (!out.good()) {
+                    out.close();
+                    fs::remove(tmp, error);
+                    return;
+                }
+            }
+
+            fs::rename(tmp, path, error);
+            if (error)
+                fs::remove(tmp, error);
+        }
+
+    private:
+        static constexpr std::array<char, 8> MAGIC = {'T', 'R', 'I', 'C', 'A', 'C', 'H', 'E'};
+
+        struct Header {
+            std::array<char, 8> magic;
+            uint32_t algorithm_version;
+            uint32_t real_size;
+            float epsilon;
+            uint32_t has_graph;
+            uint32_t has_clusters;
+            uint32_t mesh_adjacency;
+            uint32_t coplanar_sweep;
+            uint32_t merge_duplicates;
+            uint64_t hash;
+            uint64_t tri_count;
+
+            bool operator==(const Header &other) const = default;
+        };
+
+        static Header MakeHeader(uint64_t hash, size_t tri_count, const Options &options, bool has_graph, bool has_clusters) {
+            return Header{MAGIC, ALGORITHM_VERSION, sizeof(float), EPSILON,
+                          has_graph, has_clusters, options.mesh_adjacency,
+                          options.coplanar_sweep, options.merge_duplicates, hash, tri_count};
+        }
+
+        fs::path GetPath(uint64_t hash) const {
+            return dir_ / std::format("{:016x}.bin", hash);
+        }
+
+        template <typename T>
+        static bool ReadPod(std::ifstream &in, T &value) {
+            return static_cast<bool>(in.read(reinterpret_cast<char *>(&value), sizeof(T)));
+        }
+
+        template <typename T>
+        static void WritePod(std::ofstream &out, const T &value) {
+            out.write(reinterpret_cast<const char *>(&value), sizeof(T));
+        }
+
+        template <typename T>
+        static bool ReadVector(std::ifstream &in, std::vector<T> &values, size_t count) {
+            values.resize(count);
+            return static_cast<bool>(in.read(reinterpret_cast<char *>(values.data()), count * sizeof(T)));
+        }
+
+        template <typename T>
+        static void WriteVector(std::ofstream &out, const std::vector<T> &values) {
+            out.write(reinterpret_cast<const char *>(values.data()), values.size() * sizeof(T));
+        }
+
+        fs::path dir_;
+    }; // class ResultCache
+
+    // Intersects 'points' unless the cache already holds a matching result for them.
+    inline Result Intersect(const std::vector<glm::vec3> &points, const Options &options, const ResultCache &cache) {
+        uint64_t hash = HashPoints(points);
+        size_t tri_count = GetTriangleCount(points);
+
+        if (auto &&cached = cache.Load(hash, tri_count, options))
+            return std::move(*cached);
+
+        auto &&result = Intersect(points, options);
+        if (!details::IsCancelled(options))
+            cache.Store(hash, result, options);
+        return result;
+    }
+} // namespace intersection
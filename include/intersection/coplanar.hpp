@@ -0,0 +1,178 @@
+#pragma once
+
+#include "intersection/narrow.hpp"
+#include "intersection/kernels.hpp"
+#include "intersection/triangle.hpp"
+#include "parallel.hpp"
+
+#include <algorithm>
+#include <array>
+#include <cmath>
+#include <cstdint>
+#include <limits>
+#include <numeric>
+#include <utility>
+#include <vector>
+
+namespace intersection {
+    constexpr uint32_t NO_PLANE = std::numeric_limits<uint32_t>::max();
+    constexpr float PLANE_NORMAL_STEPS = 4096.0f;        // cells per unit of a normal component
+    constexpr float PLANE_OFFSET_STEPS = 1048576.0f;     // cells per scene size along the normal
+    constexpr float PLANE_MIN_OFFSET_STEP = 4.0f * EPSILON;
+
+    // Triangles grouped by quantized plane equation; planes holding a single triangle are dropped.
+    // Nearly equal planes may still fall into neighbouring cells and different keys may collide,
+    // so a bucket is a set of likely coplanar triangles, not a proof of coplanarity.
+    struct PlaneBuckets {
+        std::vector<uint32_t> bucket_of; // bucket of every figure or NO_PLANE
+        std::vector<uint32_t> offsets;   // members of bucket b are members[offsets[b] .. offsets[b + 1])
+        std::vector<uint32_t> members;
+
+        size_t GetBucketCount() const {
+            return offsets.empty() ? 0 : offsets.size() - 1;
+        }
+
+        bool IsSamePlane(uint32_t lhs, uint32_t rhs) const {
+            return !bucket_of.empty() && bucket_of[lhs] != NO_PLANE && bucket_of[lhs] == bucket_of[rhs];
+        }
+    };
+
+    namespace details {
+        constexpr uint64_t NO_PLANE_KEY = std::numeric_limits<uint64_t>::max();
+
+        inline uint64_t MixKey(uint64_t hash, int64_t value) {
+            hash ^= static_cast<uint64_t>(value) + 0x9E3779B97F4A7C15ULL + (hash << 6) + (hash >> 2);
+            hash ^= hash >> 31;
+            hash *= 0xBF58476D1CE4E5B9ULL;
+            return hash ^ (hash >> 29);
+        }
+
+        // The normal is flipped so that its dominant component is positive: a plane and its
+        // reversed copy get the same key.
+        inline uint64_t GetPlaneKey(glm::vec3 normal, const glm::vec3 &point, float offset_step) {
+            if (normal[GetDominantAxis(normal)] < 0.0f)
+                normal = -normal;
+
+            uint64_t key = 0;
+            for (int axis = 0; axis < 3; ++axis)
+                key = MixKey(key, std::llround(normal[axis] * PLANE_NORMAL_STEPS));
+            key = MixKey(key, std::llround(glm::dot(normal, point) / offset_step));
+
+            return key >> 1;
+        }
+    } // namespace details
+
+    inline PlaneBuckets BuildPlaneBuckets(const std::vector<glm::vec3> &points, const std::vector<Kind> &kinds,
+                                          const std::vector<glm::vec3> &normals) {
+        size_t tri_count = kinds.size();
+        AABB scene = GetPointBounds(points);
+        glm::vec3 extent = GetExtent(scene);
+        float offset_step = glm::max(glm::max(glm::max(extent.x, extent.y), extent.z) / PLANE_OFFSET_STEPS, PLANE_MIN_OFFSET_STEP);
+
+        std::vector<uint64_t> keys(tri_count);
+        parallel::For(tri_count, parallel::DEFAULT_GRAIN * 16, [&](size_t begin, size_t end, size_t) {
+            for (size_t i = begin; i < end; ++i)
+                keys[i] = (kinds[i] == Kind::Triangle) ? details::GetPlaneKey(normals[i], points[3 * i], offset_step)
+                                                       : details::NO_PLANE_KEY;
+        });
+
+        std::vector<uint32_t> ids(tri_count);
+        std::iota(ids.begin(), ids.end(), 0U);
+        parallel::SortByKey(keys, ids);
+
+        PlaneBuckets buckets;
+        buckets.bucket_of.assign(tri_count, NO_PLANE);
+        buckets.offsets.push_back(0U);
+        for (size_t begin = 0; begin < tri_count;) {
+            size_t end = begin + 1;
+            while (end < tri_count && keys[end] == keys[begin])
+                ++end;
+
+            if (keys[begin] != details::NO_PLANE_KEY && end - begin > 1) {
+                auto bucket = static_cast<uint32_t>(buckets.GetBucketCount());
+                for (size_t k = begin; k < end; ++k) {
+                    buckets.bucket_of[ids[k]] = bucket;
+                    buckets.members.push_back(ids[k]);
+                }
+                buckets.offsets.push_back(static_cast<uint32_t>(buckets.members.size()));
+            }
+            begin = end;
+        }
+
+        return buckets;
+    }
+
+    // Members of one plane bucket with their bounds and their corners projected once onto the
+    // dominant axis of the bucket's normal, shared by every pair of the bucket.
+    struct PlaneMembers {
+        int axis = 2;
+        std::vector<AABB> boxes;
+        std::vector<std::array<glm::vec2, 3>> projected;
+    };
+
+    inline void ProjectPlaneMembers(const std::vector<glm::vec3> &points, const uint32_t *members, size_t count,
+                                    const glm::vec3 &normal, PlaneMembers &plane) {
+        plane.axis = details::GetDominantAxis(normal);
+        plane.boxes.resize(count);
+        plane.projected.resize(count);
+        for (size_t k = 0; k < count; ++k) {
+            Triangle tri = GetTriangle(points, members[k]);
+            plane.boxes[k] = GetBounds(tri);
+            plane.projected[k] = details::Project(tri, plane.axis);
+        }
+    }
+
+    // Test for two triangles of one plane bucket. A bucket only makes coplanarity likely, so the
+    // pair's own plane distances decide: a pair lying in one plane within EPSILON takes the 2D edge
+    // and containment test on the cached projections, any other pair the 3D test.
+    inline bool IntersectInPlane(const Triangle &lhs, const glm::vec3 &lhs_normal, const std::array<glm::vec2, 3> &lhs_projected,
+                                 const Triangle &rhs, const glm::vec3 &rhs_normal, const std::array<glm::vec2, 3> &rhs_projected) {
+        std::array<float, 3> lhs_dist = {details::Snap(glm::dot(rhs_normal, lhs.a - rhs.a)),
+                                         details::Snap(glm::dot(rhs_normal, lhs.b - rhs.a)),
+                                         details::Snap(glm::dot(rhs_normal, lhs.c - rhs.a))};
+        if (details::IsSameSide(lhs_dist))
+            return false;
+
+        std::array<float, 3> rhs_dist = {details::Snap(glm::dot(lhs_normal, rhs.a - lhs.a)),
+                                         details::Snap(glm::dot(lhs_normal, rhs.b - lhs.a)),
+                                         details::Snap(glm::dot(lhs_normal, rhs.c - lhs.a))};
+        if (details::IsSameSide(rhs_dist))
+            return false;
+
+        if (details::IsZero(lhs_dist) || details::IsZero(rhs_dist))
+            return details::IntersectTriangles2D(lhs_projected, rhs_projected);
+        return IntersectTriangles(lhs, lhs_normal, rhs, rhs_normal);
+    }
+
+    // Sweep and prune inside one plane: members are sorted along an in-plane axis and only those
+    // whose intervals overlap are checked, so a flat panel never meets the octree's thin-slab problem.
+    // Calls 'visit(k, m)' with the positions in 'plane' of every pair of members with overlapping bounds.
+    template <typename VisitT>
+    void SweepPlane(const PlaneMembers &plane, std::vector<std::pair<float, uint32_t>> &sorted,
+                    std::vector<std::pair<float, uint32_t>> &active, VisitT &&visit) {
+        int axis = (plane.axis + 1) % 3;
+        size_t count = plane.boxes.size();
+
+        sorted.resize(count);
+        for (size_t k = 0; k < count; ++k)
+            sorted[k] = {plane.boxes[k].min[axis], static_cast<uint32_t>(k)};
+        std::sort(sorted.begin(), sorted.end());
+
+        active.clear();
+        for (auto [min, m] : sorted) {
+            const AABB &box = plane.boxes[m];
+            for (size_t k = 0; k < active.size();) {
+                if (active[k].first + EPSILON < min) {
+                    active[k] = active.back();
+                    active.pop_back();
+                    continue;
+                }
+
+                if (Overlaps(plane.boxes[active[k].second], box))
+                    visit(active[k].second, m);
+                ++k;
+            }
+            active.emplace_back(box.max[axis], m);
+        }
+    }
+} // namespace intersection
@@ -0,0 +1,166 @@
+#pragma once
+
+#include "intersection/adjacency.hpp"
+#include "intersection/coplanar.hpp"
+#include "intersection/triangle.hpp"
+#include "parallel.hpp"
+
+#include <algorithm>
+#include <array>
+#include <cmath>
+#include <cstdint>
+#include <limits>
+#include <numeric>
+#include <stdexcept>
+#include <vector>
+
+namespace intersection {
+    constexpr uint32_t NO_GROUP = std::numeric_limits<uint32_t>::max();
+
+    // Triangles with the same corners in any order, bit for bit. Only groups of two or more figures
+    // are kept, the first member is the group representative.
+    //
+    // With a tolerance, figures whose corners match after snapping to a grid of that step are counted
+    // as near copies. Near copies can lie apart, so each stays a representative of its own and is
+    // tested like any other figure; near copies across a cell border are not counted.
+    struct DuplicateGroups {
+        std::vector<uint32_t> group_of; // group of every figure or NO_GROUP
+        std::vector<uint32_t> offsets;  // members of group g are members[offsets[g] .. offsets[g + 1]), ascending
+        std::vector<uint32_t> members;
+        size_t near_count = 0;          // distinct figures within the tolerance of another one
+
+        size_t GetGroupCount() const {
+            return offsets.empty() ? 0 : offsets.size() - 1;
+        }
+
+        // Figures that are only tested through their representative.
+        size_t GetDuplicateCount() const {
+            return members.size() - GetGroupCount();
+        }
+
+        bool HasCopies(uint32_t index) const {
+            return !group_of.empty() && group_of[index] != NO_GROUP;
+        }
+
+        bool IsRepresentative(uint32_t index) const {
+            return !HasCopies(index) || members[offsets[group_of[index]]] == index;
+        }
+
+        // Calls 'func' for every figure of the group of 'index', or for 'index' alone.
+        template <typename FuncT>
+        void ForEachMember(uint32_t index, FuncT &&func) const {
+            if (!HasCopies(index))
+                return func(index);
+
+            uint32_t group = group_of[index];
+            for (uint32_t k = offsets[group]; k < offsets[group + 1]; ++k)
+                func(members[k]);
+        }
+    };
+
+    namespace details {
+        using CanonicalTriangle = std::array<std::array<int64_t, 3>, 3>;
+
+        inline int64_t GetCanonicalCoordinate(float value, float tolerance) {
+            return (tolerance > 0.0f) ? std::llround(value / tolerance) : int64_t{GetBits(value)};
+        }
+
+        // Corners in lexicographic order, so a triangle and its reordered or reversed copy compare equal.
+        inline CanonicalTriangle GetCanonicalTriangle(const Triangle &tri, float tolerance) {
+            CanonicalTriangle canonical;
+            for (int k = 0; k < 3; ++k)
+                for (int axis = 0; axis < 3; ++axis)
+                    canonical[k][axis] = GetCanonicalCoordinate(GetCorner(tri, k)[axis], tolerance);
+
+            std::sort(canonical.begin(), canonical.end());
+            return canonical;
+        }
+
+        inline uint64_t GetTriangleKey(const CanonicalTriangle &canonical) {
+            uint64_t key = 0;
+            for (const auto &corner : canonical)
+                for (auto value : corner)
+                    key = MixKey(key, value);
+            return key;
+        }
+    } // namespace details
+
+    // Same corners in any order, bit for bit. Such copies touch whatever their shape.
+    inline bool IsExactCopy(const std::vector<glm::vec3> &points, uint32_t lhs, uint32_t rhs) {
+        return details::GetCanonicalTriangle(GetTriangle(points, lhs), 0.0f) ==
+               details::GetCanonicalTriangle(GetTriangle(points, rhs), 0.0f);
+    }
+
+    inline DuplicateGroups FindDuplicates(const std::vector<glm::vec3> &points, float tolerance = 0.0f) {
+        if (!(tolerance >= 0.0f) || !std::isfinite(tolerance))
+            throw std::invalid_argument("Duplicate tolerance must be a finite non-negative number");
+
+        size_t tri_count = GetTriangleCount(points);
+        std::vector<uint64_t> keys(tri_count);
+        parallel::For(tri_count, parallel::DEFAULT_GRAIN * 16, [&](size_t begin, size_t end, size_t) {
+            for (size_t i = begin; i < end; ++i)
+                keys[i] = details::GetTriangleKey(details::GetCanonicalTriangle(GetTriangle(points, i), tolerance));
+        });
+
+        std::vector<uint32_t> ids(tri_count);
+        std::iota(ids.begin(), ids.end(), 0U);
+        parallel::SortByKey(keys, ids);
+
+        // The sort is stable, so every run lists its figures in input order. Runs are short unless
+        // they are real copies, and a key collision just splits a run into several groups.
+        DuplicateGroups groups;
+        groups.group_of.assign(tri_count, NO_GROUP);
+        groups.offsets.push_back(0U);
+        std::vector<details::CanonicalTriangle> run;
+        std::vector<details::CanonicalTriangle> exact;
+        std::vector<uint32_t> run_group;
+        std::vector<size_t> shapes;
+        for (size_t begin = 0; begin < tri_count;) {
+            size_t end = begin + 1;
+            while (end < tri_count && keys[end] == keys[begin])
+                ++end;
+
+            if (end - begin > 1) {
+                run.clear();
+                exact.clear();
+                for (size_t k = begin; k < end; ++k) {
+                    Triangle tri = GetTriangle(points, ids[k]);
+                    run.push_back(details::GetCanonicalTriangle(tri, tolerance));
+                    exact.push_back(details::GetCanonicalTriangle(tri, 0.0f));
+                }
+
+                // Members are appended group by group, so a run of several groups is collected per group.
+                // Every first figure of a shape that snaps onto an earlier shape is a near copy.
+                run_group.assign(end - begin, NO_GROUP);
+                shapes.clear();
+                for (size_t k = 0; k < run.size(); ++k) {
+                    if (run_group[k] != NO_GROUP)
+                        continue;
+
+                    groups.near_count += std::any_of(shapes.begin(), shapes.end(), [&](size_t shape) { return run[shape] == run[k]; });
+                    shapes.push_back(k);
+
+                    size_t first = groups.members.size();
+                    for (size_t m = k + 1; m < run.size(); ++m)
+                        if (run_group[m] == NO_GROUP && exact[m] == exact[k]) {
+                            if (groups.members.size() == first)
+                                groups.members.push_back(ids[begin + k]);
+                            groups.members.push_back(ids[begin + m]);
+                            run_group[m] = static_cast<uint32_t>(groups.GetGroupCount());
+                        }
+
+                    if (groups.members.size() == first)
+                        continue;
+
+                    auto group = static_cast<uint32_t>(groups.GetGroupCount());
+                    for (size_t m = first; m < groups.members.size(); ++m)
+                        groups.group_of[groups.members[m]] = group;
+                    groups.offsets.push_back(static_cast<uint32_t>(groups.members.size()));
+                }
+            }
+            begin = end;
+        }
+
+        return groups;
+    }
+} // namespace intersection
@@ -0,0 +1,40 @@
+#pragma once
+
+#include "intersection/narrow.hpp"
+#include "intersection/triangle.hpp"
+#include "parallel.hpp"
+
+#include <array>
+#include <vector>
+
+namespace intersection {
+    // Kind of every input figure, classified once so the pair loop never has to.
+    struct Figures {
+        std::vector<Kind> kinds;
+        std::array<size_t, KIND_COUNT> counts{};
+
+        size_t GetCount(Kind kind) const {
+            return counts[static_cast<size_t>(kind)];
+        }
+    };
+
+    inline Figures ClassifyFigures(const std::vector<glm::vec3> &points) {
+        Figures figures;
+        figures.kinds.resize(GetTriangleCount(points));
+
+        std::vector<std::array<size_t, KIND_COUNT>> counts(parallel::GetThreadCount());
+        parallel::For(figures.kinds.size(), parallel::DEFAULT_GRAIN * 16, [&](size_t begin, size_t end, size_t thread_index) {
+            for (size_t i = begin; i < end; ++i) {
+                Kind kind = GetKind(GetTriangle(points, i));
+                figures.kinds[i] = kind;
+                ++counts[thread_index][static_cast<size_t>(kind)];
+            }
+        });
+
+        for (const auto &local : counts)
+            for (size_t k = 0; k < KIND_COUNT; ++k)
+                figures.counts[k] += local[k];
+
+        return figures;
+    }
+} // namespace intersection
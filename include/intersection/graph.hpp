@@ -0,0 +1,135 @@
+#pragma once
+
+#include "parallel.hpp"
+
+#include <algorithm>
+#include <atomic>
+#include <cstdint>
+#include <utility>
+#include <vector>
+
+namespace intersection {
+    using PairBuffer = std::vector<std::pair<uint32_t, uint32_t>>;
+
+    // Intersection pairs as a symmetric adjacency graph in compressed sparse row form:
+    // the partners of triangle i are neighbors[offsets[i] .. offsets[i + 1]), sorted.
+    struct PairGraph {
+        std::vector<uint64_t> offsets;
+        std::vector<uint32_t> neighbors;
+
+        size_t GetVertexCount() const {
+            return offsets.empty() ? 0 : offsets.size() - 1;
+        }
+
+        size_t GetPairCount() const {
+            return neighbors.size() / 2;
+        }
+
+        size_t GetDegree(size_t vertex) const {
+            return offsets[vertex + 1] - offsets[vertex];
+        }
+
+        template <typename FuncT>
+        void ForEachNeighbor(size_t vertex, FuncT &&func) const {
+            for (uint64_t i = offsets[vertex]; i < offsets[vertex + 1]; ++i)
+                func(neighbors[i]);
+        }
+    };
+
+    // Merges the per-thread pair buffers into one graph. Every buffer is scattered by its own
+    // thread, slots are claimed with atomic increments, so no lock is taken.
+    inline PairGraph BuildPairGraph(size_t vertex_count, const std::vector<PairBuffer> &buffers) {
+        PairGraph graph;
+        graph.offsets.assign(vertex_count + 1, 0U);
+
+        std::vector<uint64_t> cursor(vertex_count, 0U);
+        parallel::For(buffers.size(), 1, [&](size_t begin, size_t end, size_t) {
+            for (size_t b = begin; b < end; ++b) {
+                for (auto [i, j] : buffers[b]) {
+                    std::atomic_ref<uint64_t>{cursor[i]}.fetch_add(1, std::memory_order_relaxed);
+                    std::atomic_ref<uint64_t>{cursor[j]}.fetch_add(1, std::memory_order_relaxed);
+                }
+            }
+        });
+
+        for (size_t i = 0; i < vertex_count; ++i) {
+            graph.offsets[i + 1] = graph.offsets[i] + cursor[i];
+            cursor[i] = graph.offsets[i];
+        }
+
+        graph.neighbors.resize(graph.offsets.back());
+        parallel::For(buffers.size(), 1, [&](size_t begin, size_t end, size_t) {
+            for (size_t b = begin; b < end; ++b) {
+                for (auto [i, j] : buffers[b]) {
+                    graph.neighbors[std::atomic_ref<uint64_t>{cursor[i]}.fetch_add(1, std::memory_order_relaxed)] = j;
+                    graph.neighbors[std::atomic_ref<uint64_t>{cursor[j]}.fetch_add(1, std::memory_order_relaxed)] = i;
+                }
+            }
+        });
+
+        parallel::For(vertex_count, parallel::DEFAULT_GRAIN, [&](size_t begin, size_t end, size_t) {
+            for (size_t i = begin; i < end; ++i)
+                std::sort(graph.neighbors.begin() + graph.offsets[i], graph.neighbors.begin() + graph.offsets[i + 1]);
+        });
+
+        return graph;
+    }
+
+    namespace details {
+        // Lock-free union-find: roots are always linked towards the smaller index with a CAS,
+        // finds compress paths by halving.
+        inline uint32_t FindRoot(std::vector<uint32_t> &parent, uint32_t vertex) {
+            while (true) {
+                uint32_t up = std::atomic_ref<uint32_t>{parent[vertex]}.load(std::memory_order_relaxed);
+                if (up == vertex)
+                    return vertex;
+
+                uint32_t grand = std::atomic_ref<uint32_t>{parent[up]}.load(std::memory_order_relaxed);
+                if (grand != up)
+                    std::atomic_ref<uint32_t>{parent[vertex]}.compare_exchange_weak(up, grand, std::memory_order_relaxed);
+                vertex = grand;
+            }
+        }
+
+        inline void Unite(std::vector<uint32_t> &parent, uint32_t lhs, uint32_t rhs) {
+            while (true) {
+                lhs = FindRoot(parent, lhs);
+                rhs = FindRoot(parent, rhs);
+                if (lhs == rhs)
+                    return;
+                if (lhs < rhs)
+                    std::swap(lhs, rhs);
+
+                uint32_t expected = lhs;
+                if (std::atomic_ref<uint32_t>{parent[lhs]}.compare_exchange_strong(expected, rhs, std::memory_order_relaxed))
+                    return;
+            }
+        }
+    } // namespace details
+
+    // Labels connected intersection clusters: every triangle gets the smallest triangle index of its
+    // cluster, so a triangle without partners is labelled with its own index.
+    inline std::vector<uint32_t> LabelClusters(const PairGraph &graph) {
+        size_t vertex_count = graph.GetVertexCount();
+        std::vector<uint32_t> parent(vertex_count);
+        for (size_t i = 0; i < vertex_count; ++i)
+            parent[i] = static_cast<uint32_t>(i);
+
+        parallel::For(vertex_count, parallel::DEFAULT_GRAIN, [&](size_t begin, size_t end, size_t) {
+            for (size_t i = begin; i < end; ++i)
+                graph.ForEachNeighbor(i, [&](uint32_t j) {
+                    if (i < j)
+                        details::Unite(parent, static_cast<uint32_t>(i), j);
+                });
+        });
+
+        parallel::For(vertex_count, parallel::DEFAULT_GRAIN, [&](size_t begin, size_t end, size_t) {
+            for (size_t i = begin; i < end; ++i) {
+                uint32_t root = details::FindRoot(parent, static_cast<uint32_t>(i));
+                std::atomic_ref<uint32_t>{parent[i]}.store(root, std::memory_order_relaxed);
+            }
+        });
+
+        return parent;
+    }
+} // namespace intersection
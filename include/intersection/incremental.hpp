@@ -0,0 +1,117 @@
+#pragma once
+
+#include "intersection/intersector.hpp"
+
+#include <algorithm>
+#include <stdexcept>
+#include <vector>
+
+namespace intersection {
+    // Keeps the broad-phase index and the pair adjacency of a scene alive between edits,
+    // so re-intersecting after a change only costs work proportional to the edit.
+    class IncrementalIntersector final {
+    public:
+        // Pairs follow 'options' both here and in Update(), the mode is always Mode::AllPairs.
+        explicit IncrementalIntersector(std::vector<glm::vec3> points, const Options &options = {})
+            : points_(std::move(points)), octree_(GetBounds(points_)), options_(options) {
+            options_.mode = Mode::AllPairs;
+            auto &&result = Intersect(points_, octree_, options_);
+            flags_ = std::move(result.flags);
+
+            size_t tri_count = GetTriangleCount(points_);
+            partners_.resize(tri_count);
+            for (size_t i = 0; i < tri_count; ++i) {
+                partners_[i].reserve(result.graph.GetDegree(i));
+                result.graph.ForEachNeighbor(i, [this, i](uint32_t j) { partners_[i].push_back(j); });
+            }
+        }
+
+        const Bitset &GetFlags() const {
+            return flags_;
+        }
+
+        const std::vector<glm::vec3> &GetPoints() const {
+            return points_;
+        }
+
+        const std::vector<uint32_t> &GetPartners(size_t index) const {
+            return partners_[index];
+        }
+
+        // Replaces triangles 'indices[k]' with the three points at 'points[3 * k]'. Pairs of the changed
+        // triangles are dropped, their candidates are re-tested and the flags of every touched triangle
+        // are recomputed, so a triangle whose last partner went away turns back to not-intersecting.
+        void Update(const std::vector<uint32_t> &indices, const std::vector<glm::vec3> &points) {
+            if (points.size() != 3 * indices.size())
+                throw std::invalid_argument("Incremental update needs three points per changed triangle");
+
+            std::vector<uint32_t> changed = indices;
+            std::sort(changed.begin(), changed.end());
+            if (std::adjacent_find(changed.begin(), changed.end()) != changed.end())
+                throw std::invalid_argument("Incremental update got the same triangle twice");
+
+            for (auto index : changed)
+                Unlink(index);
+
+            for (size_t k = 0; k < indices.size(); ++k) {
+                size_t index = indices[k];
+                for (size_t j = 0; j < 3; ++j)
+                    points_[3 * index + j] = points[3 * k + j];
+                octree_.Update(index, intersection::GetBounds(GetTriangle(points_, index)));
+            }
+
+            auto is_changed = [&changed](size_t index) {
+                return std::binary_search(changed.begin(), changed.end(), static_cast<uint32_t>(index));
+            };
+
+            std::vector<PairBuffer> buffers(parallel::GetThreadCount());
+            parallel::For(changed.size(), 1, [&](size_t begin, size_t end, size_t thread_index) {
+                for (size_t k = begin; k < end; ++k) {
+                    uint32_t i = changed[k];
+                    Triangle tri = GetTriangle(points_, i);
+
+                    // A pair of two changed triangles is tested from the smaller index only.
+                    octree_.Query(octree_.GetBounds(i), [&](size_t j) {
+                        if (j == i || (j < i && is_changed(j)))
+                            return;
+                        if (IntersectPair(tri, GetTriangle(points_, j), options_))
+                            buffers[thread_index].emplace_back(i, static_cast<uint32_t>(j));
+                    });
+                }
+            });
+
+            for (const auto &buffer : buffers) {
+                for (auto [i, j] : buffer) {
+                    partners_[i].push_back(j);
+                    partners_[j].push_back(i);
+                    flags_.Set(i);
+                    flags_.Set(j);
+                }
+            }
+        }
+
+    private:
+        void Unlink(uint32_t index) {
+            for (auto partner : partners_[index]) {
+                auto &list = partners_[partner];
+                auto it = std::find(list.begin(), list.end(), index);
+                if (it == list.end())
+                    continue;
+
+                *it = list.back();
+                list.pop_back();
+                if (list.empty())
+                    flags_.Reset(partner);
+            }
+
+            partners_[index].clear();
+            flags_.Reset(index);
+        }
+
+        std::vector<glm::vec3> points_;
+        Octree octree_;
+        Options options_;
+        Bitset flags_;
+        std::vector<std::vector<uint32_t>> partners_;
+    }; // class IncrementalIntersector
+} // namespace intersection
@@ -0,0 +1,440 @@
+#pragma once
+
+#include "intersection/triangle.hpp"
+#include "intersection/narrow.hpp"
+#include "intersection/figures.hpp"
+#include "intersection/octree.hpp"
+#include "intersection/linear_octree.hpp"
+#include "intersection/bitset.hpp"
+#include "intersection/graph.hpp"
+#include "intersection/kernels.hpp"
+#include "intersection/coplanar.hpp"
+#include "intersection/adjacency.hpp"
+#include "intersection/duplicates.hpp"
+#include "parallel.hpp"
+
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <format>
+#include <functional>
+#include <numeric>
+#include <ostream>
+#include <utility>
+#include <vector>
+
+namespace intersection {
+    // Bump on every change that can alter intersection results, it invalidates cached results.
+    constexpr uint32_t ALGORITHM_VERSION = 6U;
+
+    enum class Mode {
+        FlagsOnly, // only the per-triangle flag is wanted, pairs between two marked triangles are skipped
+        AllPairs   // every intersecting pair is tested and reported in the pair graph
+    };
+
+    enum class BroadPhase {
+        Octree,      // pointer-based octree built by recursive insertion
+        LinearOctree // flat Morton-code hierarchy built by parallel radix sort
+    };
+
+    struct Options {
+        Mode mode = Mode::FlagsOnly;
+        BroadPhase broad_phase = BroadPhase::Octree;
+        OctreeParams octree;         // BroadPhase::Octree only
+        bool collect_stats = false;
+        bool label_clusters = false; // AllPairs only: label connected intersection clusters
+        bool coplanar_sweep = true;  // test triangles sharing a plane by a sweep inside that plane
+        bool mesh_adjacency = false; // pairs sharing input vertices only count if they overlap beyond them
+        bool merge_duplicates = true; // copies of a figure are tested once, through the first of them
+        float duplicate_tolerance = 0.0f; // grid step for counting near copies, they are still tested
+
+        // Called from worker threads with batches of newly marked triangles while the run goes on.
+        std::function<void(std::vector<uint32_t> &&)> on_marked;
+        // Checked between traversal blocks, a cancelled run returns partial flags.
+        const std::atomic<bool> *cancel = nullptr;
+    };
+
+    struct Stats {
+        std::vector<OctreeLevelStats> octree_levels; // BroadPhase::Octree only
+        size_t point_count = 0;                      // degenerate figures of the input
+        size_t segment_count = 0;
+        size_t plane_buckets = 0;                    // coplanar_sweep only
+        size_t coplanar_count = 0;                   // triangles sharing a plane bucket
+        double coplanar_ms = 0.0;                    // bucketing and sweeps, part of total_ms
+        double total_ms = 0.0;                       // traversal of the broad-phase index
+        size_t adjacent_pairs = 0;                   // mesh_adjacency only: candidates sharing topology
+        size_t adjacent_intersections = 0;           // of them, genuine self-intersections
+        size_t duplicate_groups = 0;                 // merge_duplicates only
+        size_t duplicate_count = 0;                  // copies tested through their group representative
+        size_t near_duplicate_count = 0;             // duplicate_tolerance only: near copies, tested on their own
+        bool from_cache = false;                     // loaded from a ResultCache, nothing else is filled
+    };
+
+    struct Result {
+        Bitset flags;
+        PairGraph graph;               // AllPairs only
+        std::vector<uint32_t> clusters; // AllPairs with label_clusters only, see LabelClusters()
+        Stats stats;                   // collect_stats only
+    };
+
+    inline void PrintStats(std::ostream &out, const Stats &stats) {
+        if (stats.from_cache) {
+            out << "result loaded from the cache, no statistics\n";
+            return;
+        }
+        out << std::format("degenerate figures: {} points, {} segments\n", stats.point_count, stats.segment_count);
+        if (stats.duplicate_groups > 0)
+            out << std::format("duplicates: {} copies in {} groups\n", stats.duplicate_count, stats.duplicate_groups);
+        if (stats.near_duplicate_count > 0)
+            out << std::format("near duplicates: {}, tested on their own\n", stats.near_duplicate_count);
+        if (stats.total_ms > 0.0)
+            out << std::format("coplanar work: {} triangles in {} planes, {:.2f} of {:.2f} ms ({:.1f}%)\n",
+                               stats.coplanar_count, stats.plane_buckets, stats.coplanar_ms, stats.total_ms,
+                               100.0 * stats.coplanar_ms / stats.total_ms);
+        if (stats.adjacent_pairs > 0)
+            out << std::format("adjacent pairs: {}, self-intersecting: {}\n", stats.adjacent_pairs, stats.adjacent_intersections);
+        if (!stats.octree_levels.empty()) {
+            out << "octree level | nodes | items | max items per node\n";
+            for (size_t level = 0; level < stats.octree_levels.size(); ++level) {
+                const auto &info = stats.octree_levels[level];
+                out << std::format("{:>12} | {:>5} | {:>5} | {:>18}\n", level, info.node_count, info.item_count, info.max_items);
+            }
+        }
+    }
+
+    // One pair under the rules of a whole run: with merge_duplicates exact copies touch, with
+    // mesh_adjacency triangles sharing corners only count beyond them, and with coplanar_sweep a pair
+    // lying in one plane takes the 2D test. For callers testing pairs outside Intersect().
+    inline bool IntersectPair(const Triangle &lhs, const Triangle &rhs, const Options &options) {
+        if (options.merge_duplicates && details::GetCanonicalTriangle(lhs, 0.0f) == details::GetCanonicalTriangle(rhs, 0.0f))
+            return true;
+
+        Kind lhs_kind = GetKind(lhs), rhs_kind = GetKind(rhs);
+        if (lhs_kind != Kind::Triangle || rhs_kind != Kind::Triangle)
+            return Intersect(lhs, lhs_kind, rhs, rhs_kind);
+
+        glm::vec3 lhs_normal = details::GetNormal(lhs), rhs_normal = details::GetNormal(rhs);
+        if (options.mesh_adjacency) {
+            auto shared = GetSharedCorners(lhs, rhs);
+            if (shared.count > 0)
+                return IntersectAdjacent(lhs, lhs_normal, rhs, rhs_normal, shared);
+        }
+
+        if (!options.coplanar_sweep)
+            return IntersectTriangles(lhs, lhs_normal, rhs, rhs_normal);
+
+        int axis = details::GetDominantAxis(lhs_normal);
+        return IntersectInPlane(lhs, lhs_normal, details::Project(lhs, axis), rhs, rhs_normal, details::Project(rhs, axis));
+    }
+
+    namespace details {
+        using Clock = std::chrono::steady_clock;
+
+        constexpr size_t TRAVERSAL_GRAIN = 64U;
+        constexpr size_t MARKED_BATCH_SIZE = 4096U;
+        constexpr size_t FILTER_MIN_CANDIDATES = 4U; // below one SSE vector the filter only adds work
+
+        inline bool IsCancelled(const Options &options) {
+            return options.cancel && options.cancel->load(std::memory_order_relaxed);
+        }
+
+        inline double GetElapsedMs(Clock::time_point start) {
+            return std::chrono::duration<double, std::milli>(Clock::now() - start).count();
+        }
+
+        // Big triangles overlap the most candidates, so visiting them first marks triangles early
+        // and lets the flag-only mode skip most of the remaining pairs.
+        template <typename IndexT>
+        std::vector<uint32_t> GetTraversalOrder(const IndexT &index) {
+            std::vector<uint32_t> order(index.GetSize());
+            std::iota(order.begin(), order.end(), 0U);
+
+            std::vector<float> sizes(index.GetSize());
+            for (size_t i = 0; i < index.GetSize(); ++i) {
+                glm::vec3 extent = GetExtent(index.GetBounds(i));
+                sizes[i] = extent.x + extent.y + extent.z;
+            }
+
+            std::stable_sort(order.begin(), order.end(), [&sizes](uint32_t lhs, uint32_t rhs) {
+                return sizes[lhs] > sizes[rhs];
+            });
+
+            return order;
+        }
+    } // namespace details
+
+    // Runs the intersection over an already built broad-phase index of 'points'.
+    // Candidate pairs rejected by 'accept_pair(i, j)' are neither tested nor reported. Copies are
+    // tested through their representative, so the filter must treat copies alike.
+    template <typename IndexT, typename FilterT>
+    Result Intersect(const std::vector<glm::vec3> &points, const IndexT &index, const Options &options, FilterT &&accept_pair) {
+        auto start = details::Clock::now();
+        size_t tri_count = GetTriangleCount(points);
+        Result result{Bitset{tri_count}, {}, {}, {}};
+
+        auto order = details::GetTraversalOrder(index);
+
+        std::vector<uint32_t> rank(tri_count);
+        for (size_t i = 0; i < tri_count; ++i)
+            rank[order[i]] = static_cast<uint32_t>(i);
+
+        bool all_pairs = (options.mode == Mode::AllPairs);
+        auto figures = ClassifyFigures(points);
+        const auto &kinds = figures.kinds;
+        auto normals = GetNormals(points);
+        if (options.collect_stats) {
+            result.stats.point_count = figures.GetCount(Kind::Point);
+            result.stats.segment_count = figures.GetCount(Kind::Segment);
+        }
+
+        MeshTopology topology;
+        if (options.mesh_adjacency)
+            topology = BuildTopology(points);
+
+        DuplicateGroups duplicates;
+        if (options.merge_duplicates)
+            duplicates = FindDuplicates(points, options.duplicate_tolerance);
+
+        auto coplanar_start = details::Clock::now();
+        PlaneBuckets planes;
+        if (options.coplanar_sweep)
+            planes = BuildPlaneBuckets(points, kinds, normals);
+        double coplanar_ms = details::GetElapsedMs(coplanar_start);
+
+        std::vector<PairBuffer> buffers(parallel::GetThreadCount());
+        std::vector<std::array<std::vector<uint32_t>, KIND_COUNT>> candidate_buffers(parallel::GetThreadCount());
+        std::vector<std::vector<uint32_t>> marked(options.on_marked ? parallel::GetThreadCount() : 0);
+        auto &flags = result.flags;
+
+        auto mark = [&](uint32_t index, size_t thread_index) {
+            if (flags.Set(index) || !options.on_marked)
+                return;
+
+            auto &batch = marked[thread_index];
+            batch.push_back(index);
+            if (batch.size() >= details::MARKED_BATCH_SIZE) {
+                options.on_marked(std::move(batch));
+                batch = {};
+            }
+        };
+
+        // Triangles sharing topology are classified by IntersectAdjacent, the rest go through 'test()'.
+        // Points and segments always take the narrow phase: a shared corner proves nothing about them.
+        std::vector<std::array<size_t, 2>> adjacency_counts(parallel::GetThreadCount());
+        auto test_pair = [&](uint32_t i, uint32_t j, size_t thread_index, auto &&test) {
+            if (topology.corners.empty() || kinds[i] != Kind::Triangle || kinds[j] != Kind::Triangle)
+                return test();
+
+            auto shared = GetSharedCorners(topology, i, j);
+            if (shared.count == 0)
+                return test();
+
+            bool hit = IntersectAdjacent(GetTriangle(points, i), normals[i], GetTriangle(points, j), normals[j], shared);
+            ++adjacency_counts[thread_index][0];
+            adjacency_counts[thread_index][1] += hit;
+            return hit;
+        };
+
+        auto report = [&](uint32_t i, uint32_t j, size_t thread_index) {
+            mark(i, thread_index);
+            mark(j, thread_index);
+            if (all_pairs)
+                buffers[thread_index].emplace_back(i, j);
+        };
+
+        // Copies of a figure always intersect each other, so their groups are marked up front; in the
+        // flag-only mode that also skips every later pair between a representative and a marked triangle.
+        parallel::For(duplicates.GetGroupCount(), 1, [&](size_t begin, size_t end, size_t thread_index) {
+            for (size_t g = begin; g < end; ++g) {
+                const uint32_t *members = duplicates.members.data() + duplicates.offsets[g];
+                size_t count = duplicates.offsets[g + 1] - duplicates.offsets[g];
+
+                // Without a pair graph, linking every copy to the representative marks the whole group.
+                size_t rows = all_pairs ? count : 1;
+                for (size_t k = 0; k < rows; ++k)
+                    for (size_t m = k + 1; m < count; ++m)
+                        if (accept_pair(members[k], members[m]))
+                            report(members[k], members[m], thread_index);
+            }
+        });
+
+        // Pairs inside one plane bucket are found by the sweep and skipped by the index traversal.
+        coplanar_start = details::Clock::now();
+        std::vector<std::array<std::vector<std::pair<float, uint32_t>>, 2>> sweep_buffers(parallel::GetThreadCount());
+        std::vector<PlaneMembers> plane_members(parallel::GetThreadCount());
+        parallel::For(planes.GetBucketCount(), 1, [&](size_t begin, size_t end, size_t thread_index) {
+            if (details::IsCancelled(options))
+                return;
+
+            auto &[sorted, active] = sweep_buffers[thread_index];
+            auto &plane = plane_members[thread_index];
+            for (size_t b = begin; b < end; ++b) {
+                const uint32_t *members = planes.members.data() + planes.offsets[b];
+                size_t count = planes.offsets[b + 1] - planes.offsets[b];
+
+                ProjectPlaneMembers(points, members, count, normals[members[0]], plane);
+                SweepPlane(plane, sorted, active, [&](uint32_t k, uint32_t m) {
+                    uint32_t i = members[k], j = members[m];
+                    if (rank[i] > rank[j]) {
+                        std::swap(i, j);
+                        std::swap(k, m);
+                    }
+                    if (!all_pairs && flags.Test(i) && flags.Test(j))
+                        return;
+                    if (!duplicates.IsRepresentative(i) || !duplicates.IsRepresentative(j) || !accept_pair(i, j))
+                        return;
+                    if (test_pair(i, j, thread_index, [&] {
+                            return IntersectInPlane(GetTriangle(points, i), normals[i], plane.projected[k],
+                                                    GetTriangle(points, j), normals[j], plane.projected[m]);
+                        }))
+                        report(i, j, thread_index);
+                });
+            }
+        });
+        coplanar_ms += details::GetElapsedMs(coplanar_start);
+
+        parallel::For(tri_count, details::TRAVERSAL_GRAIN, [&](size_t begin, size_t end, size_t thread_index) {
+            if (details::IsCancelled(options))
+                return;
+
+            auto &buckets = candidate_buffers[thread_index];
+            for (size_t pos = begin; pos < end; ++pos) {
+                uint32_t i = order[pos];
+                if (!duplicates.IsRepresentative(i))
+                    continue;
+                Triangle tri = GetTriangle(points, i);
+                Kind kind = kinds[i];
+
+                // Every pair is tested once, from the triangle that comes first in the traversal order.
+                // Candidates are bucketed by kind, so each bucket runs one specialized test.
+                for (auto &bucket : buckets)
+                    bucket.clear();
+                index.Query(index.GetBounds(i), [&](size_t j) {
+                    if (rank[j] <= pos || !duplicates.IsRepresentative(static_cast<uint32_t>(j)))
+                        return;
+                    if (!all_pairs && flags.Test(i) && flags.Test(j))
+                        return;
+                    if (planes.IsSamePlane(i, static_cast<uint32_t>(j)))
+                        return;
+                    if (accept_pair(i, static_cast<uint32_t>(j)))
+                        buckets[static_cast<size_t>(kinds[j])].push_back(static_cast<uint32_t>(j));
+                });
+
+                // Candidates entirely on one side of the plane are dropped in bulk by the vector kernel.
+                std::array<size_t, KIND_COUNT> counts;
+                for (size_t k = 0; k < KIND_COUNT; ++k) {
+                    auto &bucket = buckets[k];
+                    counts[k] = bucket.size();
+                    if (kind == Kind::Triangle && counts[k] >= details::FILTER_MIN_CANDIDATES)
+                        counts[k] = FilterPlaneSide(tri, points, bucket.data(), counts[k], bucket.data());
+                }
+
+                auto test_bucket = [&](Kind other, auto &&test) {
+                    const auto &bucket = buckets[static_cast<size_t>(other)];
+                    for (size_t k = 0; k < counts[static_cast<size_t>(other)]; ++k) {
+                        uint32_t j = bucket[k];
+                        if (!all_pairs && flags.Test(i) && flags.Test(j))
+                            continue;
+                        if (test_pair(i, j, thread_index, [&] { return test(j, GetTriangle(points, j)); }))
+                            report(i, j, thread_index);
+                    }
+                };
+
+                if (kind == Kind::Triangle) {
+                    test_bucket(Kind::Triangle, [&](uint32_t j, const Triangle &other) { return IntersectTriangles(tri, normals[i], other, normals[j]); });
+                    test_bucket(Kind::Segment, [&](uint32_t, const Triangle &other) { return IntersectSegmentTriangle(GetSegment(other), tri); });
+                    test_bucket(Kind::Point, [&](uint32_t, const Triangle &other) { return IntersectPointTriangle(other.a, tri); });
+                } else if (kind == Kind::Segment) {
+                    Segment seg = GetSegment(tri);
+                    test_bucket(Kind::Triangle, [&](uint32_t, const Triangle &other) { return IntersectSegmentTriangle(seg, other); });
+                    test_bucket(Kind::Segment, [&](uint32_t, const Triangle &other) { return GetDistance(seg, GetSegment(other)) <= EPSILON; });
+                    test_bucket(Kind::Point, [&](uint32_t, const Triangle &other) { return GetDistance(other.a, seg) <= EPSILON; });
+                } else {
+                    test_bucket(Kind::Triangle, [&](uint32_t, const Triangle &other) { return IntersectPointTriangle(tri.a, other); });
+                    test_bucket(Kind::Segment, [&](uint32_t, const Triangle &other) { return GetDistance(tri.a, GetSegment(other)) <= EPSILON; });
+                    test_bucket(Kind::Point, [&](uint32_t, const Triangle &other) { return glm::length(tri.a - other.a) <= EPSILON; });
+                }
+            }
+        });
+
+        // The flag of a representative holds for all its copies, whatever the mode and the filter.
+        parallel::For(duplicates.GetGroupCount(), 1, [&](size_t begin, size_t end, size_t thread_index) {
+            for (size_t g = begin; g < end; ++g) {
+                uint32_t first = duplicates.offsets[g];
+                if (!flags.Test(duplicates.members[first]))
+                    continue;
+                for (uint32_t k = first + 1; k < duplicates.offsets[g + 1]; ++k)
+                    mark(duplicates.members[k], thread_index);
+            }
+        });
+
+        for (auto &batch : marked)
+            if (!batch.empty())
+                options.on_marked(std::move(batch));
+
+        // A pair found for representatives holds for all their copies.
+        if (all_pairs && duplicates.GetGroupCount() > 0) {
+            parallel::For(buffers.size(), 1, [&](size_t begin, size_t end, size_t) {
+                for (size_t b = begin; b < end; ++b) {
+                    auto &buffer = buffers[b];
+                    size_t count = buffer.size();
+                    for (size_t k = 0; k < count; ++k) {
+                        auto [i, j] = buffer[k];
+                        if (duplicates.group_of[i] == duplicates.group_of[j])
+                            continue; // no copies, or a pair inside one group added up front
+                        duplicates.ForEachMember(i, [&](uint32_t lhs) {
+                            duplicates.ForEachMember(j, [&](uint32_t rhs) {
+                                if (lhs != i || rhs != j)
+                                    buffer.emplace_back(lhs, rhs);
+                            });
+                        });
+                    }
+                }
+            });
+        }
+
+        if (all_pairs) {
+            result.graph = BuildPairGraph(tri_count, buffers);
+            if (options.label_clusters)
+                result.clusters = LabelClusters(result.graph);
+        }
+
+        if (options.collect_stats) {
+            result.stats.plane_buckets = planes.GetBucketCount();
+            result.stats.coplanar_count = planes.members.size();
+            result.stats.coplanar_ms = coplanar_ms;
+            result.stats.total_ms = details::GetElapsedMs(start);
+            result.stats.duplicate_groups = duplicates.GetGroupCount();
+            result.stats.duplicate_count = duplicates.GetDuplicateCount();
+            result.stats.near_duplicate_count = duplicates.near_count;
+            for (const auto &counts : adjacency_counts) {
+                result.stats.adjacent_pairs += counts[0];
+                result.stats.adjacent_intersections += counts[1];
+            }
+        }
+
+        return result;
+    }
+
+    inline Result Intersect(const std::vector<glm::vec3> &points, const Octree &octree, const Options &options = {}) {
+        return Intersect(points, octree, options, [](uint32_t, uint32_t) { return true; });
+    }
+
+    inline Result Intersect(const std::vector<glm::vec3> &points, const LinearOctree &octree, const Options &options = {}) {
+        return Intersect(points, octree, options, [](uint32_t, uint32_t) { return true; });
+    }
+
+    inline Result Intersect(const std::vector<glm::vec3> &points, const Options &options = {}) {
+        if (options.broad_phase == BroadPhase::LinearOctree) {
+            LinearOctree octree{points};
+            return Intersect(points, octree, options);
+        }
+
+        Octree octree{GetBounds(points), options.octree};
+        auto &&result = Intersect(points, octree, options);
+        if (options.collect_stats)
+            result.stats.octree_levels = octree.GetLevelStats();
+        return result;
+    }
+} // namespace intersection
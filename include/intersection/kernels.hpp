@@ -0,0 +1,476 @@
+#pragma once
+
+#include "intersection/narrow.hpp"
+#include "intersection/triangle.hpp"
+#include "parallel.hpp"
+#include "simd.hpp"
+
+#include <cstdint>
+#include <limits>
+#include <vector>
+
+#if TRIANGLES_X86_KERNELS
+    #include <immintrin.h>
+#endif
+
+// Hot geometry loops with one variant per instruction set. The scalar variant is the reference:
+// the vector ones do the same float operations in the same order, so all of them agree exactly.
+// Contraction into FMA would break that (AVX-512 brings FMA along), so it is switched off here.
+// Vertex coordinates are read as a flat float array of x, y, z triples.
+#if defined(__clang__)
+    #pragma float_control(push)
+    #pragma clang fp contract(off)
+#elif defined(__GNUC__)
+    #pragma GCC push_options
+    #pragma GCC optimize("fp-contract=off")
+#endif
+
+namespace intersection {
+    static_assert(sizeof(glm::vec3) == 3 * sizeof(float), "kernels expect tightly packed vertices");
+
+    // A candidate whose vertices are all farther than this from the plane of the query triangle
+    // is rejected. It is twice the narrow-phase tolerance, so a rounding difference near the
+    // threshold can only keep a pair for the exact test, never drop one.
+    constexpr float PLANE_REJECT_DISTANCE = 2.0f * EPSILON;
+
+    namespace kernels {
+        namespace details {
+            // Folds per-lane minima and maxima of a flat x, y, z stream into 'box', lane k holds axis k % 3.
+            inline void FoldLanes(const float *lo, const float *hi, size_t lanes, AABB &box) {
+                for (size_t k = 0; k < lanes; ++k) {
+                    box.min[k % 3] = glm::min(box.min[k % 3], lo[k]);
+                    box.max[k % 3] = glm::max(box.max[k % 3], hi[k]);
+                }
+            }
+        } // namespace details
+
+        namespace scalar {
+            inline AABB GetPointBounds(const glm::vec3 *points, size_t count) {
+                AABB box{points[0], points[0]};
+                for (size_t i = 1; i < count; ++i) {
+                    box.min = glm::min(box.min, points[i]);
+                    box.max = glm::max(box.max, points[i]);
+                }
+
+                return box;
+            }
+
+            inline void GetNormals(const glm::vec3 *points, size_t tri_count, glm::vec3 *normals) {
+                for (size_t t = 0; t < tri_count; ++t)
+                    normals[t] = intersection::details::GetNormal(Triangle{points[3 * t], points[3 * t + 1], points[3 * t + 2]});
+            }
+
+            // Copies to 'survivors' the candidate triangles not lying entirely on one side of the
+            // plane of 'tri'. 'survivors' may be 'candidates' itself. Returns the survivor count.
+            inline size_t FilterPlaneSide(const Triangle &tri, const glm::vec3 *points, const uint32_t *candidates,
+                                          size_t count, uint32_t *survivors) {
+                glm::vec3 normal = intersection::details::GetNormal(tri);
+                size_t kept = 0;
+
+                for (size_t k = 0; k < count; ++k) {
+                    uint32_t j = candidates[k];
+                    int above = 0, below = 0;
+                    for (size_t v = 0; v < 3; ++v) {
+                        const glm::vec3 &p = points[3 * size_t{j} + v];
+                        float dist = normal.x * (p.x - tri.a.x) + normal.y * (p.y - tri.a.y) + normal.z * (p.z - tri.a.z);
+                        above += (dist > PLANE_REJECT_DISTANCE);
+                        below += (dist < -PLANE_REJECT_DISTANCE);
+                    }
+
+                    if (above < 3 && below < 3)
+                        survivors[kept++] = j;
+                }
+
+                return kept;
+            }
+        } // namespace scalar
+
+#if TRIANGLES_X86_KERNELS
+        namespace sse42 {
+            constexpr size_t WIDTH = 4U;
+
+            TRIANGLES_TARGET("sse4.2") inline AABB GetPointBounds(const glm::vec3 *points, size_t count) {
+                if (count < WIDTH)
+                    return scalar::GetPointBounds(points, count);
+
+                const float *data = &points[0].x;
+                __m128 lo[3], hi[3];
+                for (size_t m = 0; m < 3; ++m)
+                    lo[m] = hi[m] = _mm_loadu_ps(data + m * WIDTH);
+
+                size_t i = WIDTH;
+                for (; i + WIDTH <= count; i += WIDTH) {
+                    const float *block = data + 3 * i;
+                    for (size_t m = 0; m < 3; ++m) {
+                        __m128 value = _mm_loadu_ps(block + m * WIDTH);
+                        lo[m] = _mm_min_ps(lo[m], value);
+                        hi[m] = _mm_max_ps(hi[m], value);
+                    }
+                }
+
+                float lo_lanes[3 * WIDTH], hi_lanes[3 * WIDTH];
+                for (size_t m = 0; m < 3; ++m) {
+                    _mm_storeu_ps(lo_lanes + m * WIDTH, lo[m]);
+                    _mm_storeu_ps(hi_lanes + m * WIDTH, hi[m]);
+                }
+
+                AABB box{points[0], points[0]};
+                details::FoldLanes(lo_lanes, hi_lanes, 3 * WIDTH, box);
+                for (; i < count; ++i) {
+                    box.min = glm::min(box.min, points[i]);
+                    box.max = glm::max(box.max, points[i]);
+                }
+
+                return box;
+            }
+
+            TRIANGLES_TARGET("sse4.2") inline void GetNormals(const glm::vec3 *points, size_t tri_count, glm::vec3 *normals) {
+                const float *data = &points[0].x;
+                size_t t = 0;
+
+                for (; t + WIDTH <= tri_count; t += WIDTH) {
+                    const float *block = data + 9 * t;
+                    __m128 v[9];
+                    for (size_t c = 0; c < 9; ++c)
+                        v[c] = _mm_setr_ps(block[c], block[9 + c], block[18 + c], block[27 + c]);
+
+                    __m128 e1x = _mm_sub_ps(v[3], v[0]), e1y = _mm_sub_ps(v[4], v[1]), e1z = _mm_sub_ps(v[5], v[2]);
+                    __m128 e2x = _mm_sub_ps(v[6], v[0]), e2y = _mm_sub_ps(v[7], v[1]), e2z = _mm_sub_ps(v[8], v[2]);
+
+                    __m128 nx = _mm_sub_ps(_mm_mul_ps(e1y, e2z), _mm_mul_ps(e2y, e1z));
+                    __m128 ny = _mm_sub_ps(_mm_mul_ps(e1z, e2x), _mm_mul_ps(e2z, e1x));
+                    __m128 nz = _mm_sub_ps(_mm_mul_ps(e1x, e2y), _mm_mul_ps(e2x, e1y));
+
+                    __m128 len2 = _mm_add_ps(_mm_add_ps(_mm_mul_ps(nx, nx), _mm_mul_ps(ny, ny)), _mm_mul_ps(nz, nz));
+                    __m128 inv = _mm_div_ps(_mm_set1_ps(1.0f), _mm_sqrt_ps(len2));
+
+                    float x[WIDTH], y[WIDTH], z[WIDTH];
+                    _mm_storeu_ps(x, _mm_mul_ps(nx, inv));
+                    _mm_storeu_ps(y, _mm_mul_ps(ny, inv));
+                    _mm_storeu_ps(z, _mm_mul_ps(nz, inv));
+                    for (size_t k = 0; k < WIDTH; ++k)
+                        normals[t + k] = glm::vec3{x[k], y[k], z[k]};
+                }
+
+                scalar::GetNormals(points + 3 * t, tri_count - t, normals + t);
+            }
+
+            TRIANGLES_TARGET("sse4.2") inline size_t FilterPlaneSide(const Triangle &tri, const glm::vec3 *points,
+                                                                    const uint32_t *candidates, size_t count, uint32_t *survivors) {
+                glm::vec3 normal = intersection::details::GetNormal(tri);
+                __m128 nx = _mm_set1_ps(normal.x), ny = _mm_set1_ps(normal.y), nz = _mm_set1_ps(normal.z);
+                __m128 ax = _mm_set1_ps(tri.a.x), ay = _mm_set1_ps(tri.a.y), az = _mm_set1_ps(tri.a.z);
+                __m128 upper = _mm_set1_ps(PLANE_REJECT_DISTANCE), lower = _mm_set1_ps(-PLANE_REJECT_DISTANCE);
+
+                const float *data = &points[0].x;
+                size_t kept = 0, k = 0;
+                for (; k + WIDTH <= count; k += WIDTH) {
+                    uint32_t lane[WIDTH];
+                    const float *vertex[WIDTH];
+                    for (size_t l = 0; l < WIDTH; ++l) {
+                        lane[l] = candidates[k + l];
+                        vertex[l] = data + 9 * size_t{lane[l]};
+                    }
+
+                    __m128 above = _mm_castsi128_ps(_mm_set1_epi32(-1)), below = above;
+                    for (size_t v = 0; v < 9; v += 3) {
+                        __m128 x = _mm_setr_ps(vertex[0][v + 0], vertex[1][v + 0], vertex[2][v + 0], vertex[3][v + 0]);
+                        __m128 y = _mm_setr_ps(vertex[0][v + 1], vertex[1][v + 1], vertex[2][v + 1], vertex[3][v + 1]);
+                        __m128 z = _mm_setr_ps(vertex[0][v + 2], vertex[1][v + 2], vertex[2][v + 2], vertex[3][v + 2]);
+
+                        __m128 dist = _mm_add_ps(_mm_add_ps(_mm_mul_ps(nx, _mm_sub_ps(x, ax)), _mm_mul_ps(ny, _mm_sub_ps(y, ay))),
+                                                 _mm_mul_ps(nz, _mm_sub_ps(z, az)));
+                        above = _mm_and_ps(above, _mm_cmpgt_ps(dist, upper));
+                        below = _mm_and_ps(below, _mm_cmplt_ps(dist, lower));
+                    }
+
+                    int rejected = _mm_movemask_ps(_mm_or_ps(above, below));
+                    for (size_t l = 0; l < WIDTH; ++l)
+                        if (!(rejected & (1 << l)))
+                            survivors[kept++] = lane[l];
+                }
+
+                return kept + scalar::FilterPlaneSide(tri, points, candidates + k, count - k, survivors + kept);
+            }
+        } // namespace sse42
+
+        namespace avx2 {
+            constexpr size_t WIDTH = 8U;
+
+            TRIANGLES_TARGET("avx2") inline AABB GetPointBounds(const glm::vec3 *points, size_t count) {
+                if (count < WIDTH)
+                    return scalar::GetPointBounds(points, count);
+
+                const float *data = &points[0].x;
+                __m256 lo[3], hi[3];
+                for (size_t m = 0; m < 3; ++m)
+                    lo[m] = hi[m] = _mm256_loadu_ps(data + m * WIDTH);
+
+                size_t i = WIDTH;
+                for (; i + WIDTH <= count; i += WIDTH) {
+                    const float *block = data + 3 * i;
+                    for (size_t m = 0; m < 3; ++m) {
+                        __m256 value = _mm256_loadu_ps(block + m * WIDTH);
+                        lo[m] = _mm256_min_ps(lo[m], value);
+                        hi[m] = _mm256_max_ps(hi[m], value);
+                    }
+                }
+
+                float lo_lanes[3 * WIDTH], hi_lanes[3 * WIDTH];
+                for (size_t m = 0; m < 3; ++m) {
+                    _mm256_storeu_ps(lo_lanes + m * WIDTH, lo[m]);
+                    _mm256_storeu_ps(hi_lanes + m * WIDTH, hi[m]);
+                }
+
+                AABB box{points[0], points[0]};
+                details::FoldLanes(lo_lanes, hi_lanes, 3 * WIDTH, box);
+                for (; i < count; ++i) {
+                    box.min = glm::min(box.min, points[i]);
+                    box.max = glm::max(box.max, points[i]);
+                }
+
+                return box;
+            }
+
+            TRIANGLES_TARGET("avx2") inline void GetNormals(const glm::vec3 *points, size_t tri_count, glm::vec3 *normals) {
+                const float *data = &points[0].x;
+                const __m256i offsets = _mm256_setr_epi32(0, 9, 18, 27, 36, 45, 54, 63);
+                size_t t = 0;
+
+                for (; t + WIDTH <= tri_count; t += WIDTH) {
+                    const float *block = data + 9 * t;
+                    __m256 v[9];
+                    for (size_t c = 0; c < 9; ++c)
+                        v[c] = _mm256_i32gather_ps(block + c, offsets, 4);
+
+                    __m256 e1x = _mm256_sub_ps(v[3], v[0]), e1y = _mm256_sub_ps(v[4], v[1]), e1z = _mm256_sub_ps(v[5], v[2]);
+                    __m256 e2x = _mm256_sub_ps(v[6], v[0]), e2y = _mm256_sub_ps(v[7], v[1]), e2z = _mm256_sub_ps(v[8], v[2]);
+
+                    __m256 nx = _mm256_sub_ps(_mm256_mul_ps(e1y, e2z), _mm256_mul_ps(e2y, e1z));
+                    __m256 ny = _mm256_sub_ps(_mm256_mul_ps(e1z, e2x), _mm256_mul_ps(e2z, e1x));
+                    __m256 nz = _mm256_sub_ps(_mm256_mul_ps(e1x, e2y), _mm256_mul_ps(e2x, e1y));
+
+                    __m256 len2 = _mm256_add_ps(_mm256_add_ps(_mm256_mul_ps(nx, nx), _mm256_mul_ps(ny, ny)), _mm256_mul_ps(nz, nz));
+                    __m256 inv = _mm256_div_ps(_mm256_set1_ps(1.0f), _mm256_sqrt_ps(len2));
+
+                    float x[WIDTH], y[WIDTH], z[WIDTH];
+                    _mm256_storeu_ps(x, _mm256_mul_ps(nx, inv));
+                    _mm256_storeu_ps(y, _mm256_mul_ps(ny, inv));
+                    _mm256_storeu_ps(z, _mm256_mul_ps(nz, inv));
+                    for (size_t k = 0; k < WIDTH; ++k)
+                        normals[t + k] = glm::vec3{x[k], y[k], z[k]};
+                }
+
+                scalar::GetNormals(points + 3 * t, tri_count - t, normals + t);
+            }
+
+            // Gathers use 32-bit offsets, so the vertex array must hold less than 2^31 floats.
+            TRIANGLES_TARGET("avx2") inline size_t FilterPlaneSide(const Triangle &tri, const glm::vec3 *points,
+                                                                  const uint32_t *candidates, size_t count, uint32_t *survivors) {
+                glm::vec3 normal = intersection::details::GetNormal(tri);
+                __m256 nx = _mm256_set1_ps(normal.x), ny = _mm256_set1_ps(normal.y), nz = _mm256_set1_ps(normal.z);
+                __m256 ax = _mm256_set1_ps(tri.a.x), ay = _mm256_set1_ps(tri.a.y), az = _mm256_set1_ps(tri.a.z);
+                __m256 upper = _mm256_set1_ps(PLANE_REJECT_DISTANCE), lower = _mm256_set1_ps(-PLANE_REJECT_DISTANCE);
+
+                const float *data = &points[0].x;
+                size_t kept = 0, k = 0;
+                for (; k + WIDTH <= count; k += WIDTH) {
+                    __m256i lanes = _mm256_loadu_si256(reinterpret_cast<const __m256i *>(candidates + k));
+                    __m256i base = _mm256_mullo_epi32(lanes, _mm256_set1_epi32(9));
+
+                    __m256 above = _mm256_castsi256_ps(_mm256_set1_epi32(-1)), below = above;
+                    for (size_t v = 0; v < 9; v += 3) {
+                        __m256 x = _mm256_i32gather_ps(data + v + 0, base, 4);
+                        __m256 y = _mm256_i32gather_ps(data + v + 1, base, 4);
+                        __m256 z = _mm256_i32gather_ps(data + v + 2, base, 4);
+
+                        __m256 dist = _mm256_add_ps(_mm256_add_ps(_mm256_mul_ps(nx, _mm256_sub_ps(x, ax)), _mm256_mul_ps(ny, _mm256_sub_ps(y, ay))),
+                                                    _mm256_mul_ps(nz, _mm256_sub_ps(z, az)));
+                        above = _mm256_and_ps(above, _mm256_cmp_ps(dist, upper, _CMP_GT_OQ));
+                        below = _mm256_and_ps(below, _mm256_cmp_ps(dist, lower, _CMP_LT_OQ));
+                    }
+
+                    uint32_t lane[WIDTH];
+                    _mm256_storeu_si256(reinterpret_cast<__m256i *>(lane), lanes);
+                    int rejected = _mm256_movemask_ps(_mm256_or_ps(above, below));
+                    for (size_t l = 0; l < WIDTH; ++l)
+                        if (!(rejected & (1 << l)))
+                            survivors[kept++] = lane[l];
+                }
+
+                return kept + scalar::FilterPlaneSide(tri, points, candidates + k, count - k, survivors + kept);
+            }
+        } // namespace avx2
+
+// GCC 12 reports the deliberately undefined pass-through operand inside avx512fintrin.h.
+#if defined(__GNUC__) && !defined(__clang__)
+    #pragma GCC diagnostic push
+    #pragma GCC diagnostic ignored "-Wmaybe-uninitialized"
+#endif
+        namespace avx512 {
+            constexpr size_t WIDTH = 16U;
+
+            TRIANGLES_TARGET("avx512f") inline AABB GetPointBounds(const glm::vec3 *points, size_t count) {
+                if (count < WIDTH)
+                    return scalar::GetPointBounds(points, count);
+
+                const float *data = &points[0].x;
+                __m512 lo[3], hi[3];
+                for (size_t m = 0; m < 3; ++m)
+                    lo[m] = hi[m] = _mm512_loadu_ps(data + m * WIDTH);
+
+                size_t i = WIDTH;
+                for (; i + WIDTH <= count; i += WIDTH) {
+                    const float *block = data + 3 * i;
+                    for (size_t m = 0; m < 3; ++m) {
+                        __m512 value = _mm512_loadu_ps(block + m * WIDTH);
+                        lo[m] = _mm512_min_ps(lo[m], value);
+                        hi[m] = _mm512_max_ps(hi[m], value);
+                    }
+                }
+
+                float lo_lanes[3 * WIDTH], hi_lanes[3 * WIDTH];
+                for (size_t m = 0; m < 3; ++m) {
+                    _mm512_storeu_ps(lo_lanes + m * WIDTH, lo[m]);
+                    _mm512_storeu_ps(hi_lanes + m * WIDTH, hi[m]);
+                }
+
+                AABB box{points[0], points[0]};
+                details::FoldLanes(lo_lanes, hi_lanes, 3 * WIDTH, box);
+                for (; i < count; ++i) {
+                    box.min = glm::min(box.min, points[i]);
+                    box.max = glm::max(box.max, points[i]);
+                }
+
+                return box;
+            }
+
+            TRIANGLES_TARGET("avx512f") inline void GetNormals(const glm::vec3 *points, size_t tri_count, glm::vec3 *normals) {
+                const float *data = &points[0].x;
+                const __m512i offsets = _mm512_setr_epi32(0, 9, 18, 27, 36, 45, 54, 63, 72, 81, 90, 99, 108, 117, 126, 135);
+                size_t t = 0;
+
+                for (; t + WIDTH <= tri_count; t += WIDTH) {
+                    const float *block = data + 9 * t;
+                    __m512 v[9];
+                    for (size_t c = 0; c < 9; ++c)
+                        v[c] = _mm512_i32gather_ps(offsets, block + c, 4);
+
+                    __m512 e1x = _mm512_sub_ps(v[3], v[0]), e1y = _mm512_sub_ps(v[4], v[1]), e1z = _mm512_sub_ps(v[5], v[2]);
+                    __m512 e2x = _mm512_sub_ps(v[6], v[0]), e2y = _mm512_sub_ps(v[7], v[1]), e2z = _mm512_sub_ps(v[8], v[2]);
+
+                    __m512 nx = _mm512_sub_ps(_mm512_mul_ps(e1y, e2z), _mm512_mul_ps(e2y, e1z));
+                    __m512 ny = _mm512_sub_ps(_mm512_mul_ps(e1z, e2x), _mm512_mul_ps(e2z, e1x));
+                    __m512 nz = _mm512_sub_ps(_mm512_mul_ps(e1x, e2y), _mm512_mul_ps(e2x, e1y));
+
+                    __m512 len2 = _mm512_add_ps(_mm512_add_ps(_mm512_mul_ps(nx, nx), _mm512_mul_ps(ny, ny)), _mm512_mul_ps(nz, nz));
+                    __m512 inv = _mm512_div_ps(_mm512_set1_ps(1.0f), _mm512_sqrt_ps(len2));
+
+                    float x[WIDTH], y[WIDTH], z[WIDTH];
+                    _mm512_storeu_ps(x, _mm512_mul_ps(nx, inv));
+                    _mm512_storeu_ps(y, _mm512_mul_ps(ny, inv));
+                    _mm512_storeu_ps(z, _mm512_mul_ps(nz, inv));
+                    for (size_t k = 0; k < WIDTH; ++k)
+                        normals[t + k] = glm::vec3{x[k], y[k], z[k]};
+                }
+
+                scalar::GetNormals(points + 3 * t, tri_count - t, normals + t);
+            }
+
+            // Gathers use 32-bit offsets, so the vertex array must hold less than 2^31 floats.
+            TRIANGLES_TARGET("avx512f") inline size_t FilterPlaneSide(const Triangle &tri, const glm::vec3 *points,
+                                                                     const uint32_t *candidates, size_t count, uint32_t *survivors) {
+                glm::vec3 normal = intersection::details::GetNormal(tri);
+                __m512 nx = _mm512_set1_ps(normal.x), ny = _mm512_set1_ps(normal.y), nz = _mm512_set1_ps(normal.z);
+                __m512 ax = _mm512_set1_ps(tri.a.x), ay = _mm512_set1_ps(tri.a.y), az = _mm512_set1_ps(tri.a.z);
+                __m512 upper = _mm512_set1_ps(PLANE_REJECT_DISTANCE), lower = _mm512_set1_ps(-PLANE_REJECT_DISTANCE);
+
+                const float *data = &points[0].x;
+                size_t kept = 0, k = 0;
+                for (; k + WIDTH <= count; k += WIDTH) {
+                    __m512i lanes = _mm512_loadu_si512(candidates + k);
+                    __m512i base = _mm512_mullo_epi32(lanes, _mm512_set1_epi32(9));
+
+                    __mmask16 above = 0xFFFF, below = 0xFFFF;
+                    for (size_t v = 0; v < 9; v += 3) {
+                        __m512 x = _mm512_i32gather_ps(base, data + v + 0, 4);
+                        __m512 y = _mm512_i32gather_ps(base, data + v + 1, 4);
+                        __m512 z = _mm512_i32gather_ps(base, data + v + 2, 4);
+
+                        __m512 dist = _mm512_add_ps(_mm512_add_ps(_mm512_mul_ps(nx, _mm512_sub_ps(x, ax)), _mm512_mul_ps(ny, _mm512_sub_ps(y, ay))),
+                                                    _mm512_mul_ps(nz, _mm512_sub_ps(z, az)));
+                        above &= _mm512_cmp_ps_mask(dist, upper, _CMP_GT_OQ);
+                        below &= _mm512_cmp_ps_mask(dist, lower, _CMP_LT_OQ);
+                    }
+
+                    __mmask16 keep = static_cast<__mmask16>(~(above | below));
+                    _mm512_mask_compressstoreu_epi32(survivors + kept, keep, lanes);
+                    kept += static_cast<size_t>(__builtin_popcount(keep));
+                }
+
+                return kept + scalar::FilterPlaneSide(tri, points, candidates + k, count - k, survivors + kept);
+            }
+        } // namespace avx512
+#if defined(__GNUC__) && !defined(__clang__)
+    #pragma GCC diagnostic pop
+#endif
+#endif
+
+        struct KernelTable {
+            AABB (*get_point_bounds)(const glm::vec3 *points, size_t count);
+            void (*get_normals)(const glm::vec3 *points, size_t tri_count, glm::vec3 *normals);
+            size_t (*filter_plane_side)(const Triangle &tri, const glm::vec3 *points, const uint32_t *candidates,
+                                        size_t count, uint32_t *survivors);
+        };
+
+        // Kernels of the given level; levels the build cannot target fall back to scalar.
+        inline KernelTable GetKernels(simd::Isa isa) {
+            switch (isa) {
+#if TRIANGLES_X86_KERNELS
+                case simd::Isa::AVX512: return {avx512::GetPointBounds, avx512::GetNormals, avx512::FilterPlaneSide};
+                case simd::Isa::AVX2:   return {avx2::GetPointBounds, avx2::GetNormals, avx2::FilterPlaneSide};
+                case simd::Isa::SSE42:  return {sse42::GetPointBounds, sse42::GetNormals, sse42::FilterPlaneSide};
+#endif
+                default:                return {scalar::GetPointBounds, scalar::GetNormals, scalar::FilterPlaneSide};
+            }
+        }
+
+        // Kernels of the level chosen at run time, see simd::GetIsa.
+        inline const KernelTable &GetKernels() {
+            static const KernelTable table = GetKernels(simd::GetIsa());
+            return table;
+        }
+    } // namespace kernels
+
+    inline AABB GetPointBounds(const std::vector<glm::vec3> &points) {
+        if (points.empty())
+            return AABB{glm::vec3(0.0f), glm::vec3(0.0f)};
+        return kernels::GetKernels().get_point_bounds(points.data(), points.size());
+    }
+
+    // Unit normal of every triangle, computed in parallel.
+    inline std::vector<glm::vec3> GetNormals(const std::vector<glm::vec3> &points) {
+        std::vector<glm::vec3> normals(GetTriangleCount(points));
+        auto get_normals = kernels::GetKernels().get_normals;
+
+        parallel::For(normals.size(), parallel::DEFAULT_GRAIN * 16, [&](size_t begin, size_t end, size_t) {
+            get_normals(points.data() + 3 * begin, end - begin, normals.data() + begin);
+        });
+
+        return normals;
+    }
+
+    // Plane-side rejection of the candidates of 'tri', see kernels::scalar::FilterPlaneSide.
+    inline size_t FilterPlaneSide(const Triangle &tri, const std::vector<glm::vec3> &points, const uint32_t *candidates,
+                                  size_t count, uint32_t *survivors) {
+        if (3 * points.size() > static_cast<size_t>(std::numeric_limits<int32_t>::max()))
+            return kernels::scalar::FilterPlaneSide(tri, points.data(), candidates, count, survivors);
+        return kernels::GetKernels().filter_plane_side(tri, points.data(), candidates, count, survivors);
+    }
+} // namespace intersection
+
+#if defined(__clang__)
+    #pragma float_control(pop)
+#elif defined(__GNUC__)
+    #pragma GCC pop_options
+#endif
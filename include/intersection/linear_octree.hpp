@@ -0,0 +1,165 @@
+#pragma once
+
+#include "intersection/triangle.hpp"
+#include "intersection/morton.hpp"
+#include "parallel.hpp"
+
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <bit>
+#include <limits>
+#include <numeric>
+#include <vector>
+
+namespace intersection {
+    // Linear octree over the Morton codes of triangle centroids. The hierarchy is the binary radix
+    // tree of the sorted codes (Karras, 2012): every internal node splits its key range at the highest
+    // differing bit, so three consecutive levels make one octree level. Internal nodes and leaves live
+    // in one flat array, [0, n - 1) are internal and [n - 1, 2n - 1) are the leaves in key order.
+    class LinearOctree final {
+    public:
+        explicit LinearOctree(const std::vector<glm::vec3> &points) : bounds_(intersection::GetBounds(points)) {
+            size_t count = bounds_.size();
+            if (count == 0)
+                return;
+
+            auto &&codes = GetMortonCodes(points, GetCentroidBounds(points));
+            std::vector<uint32_t> order(count);
+            std::iota(order.begin(), order.end(), 0U);
+            parallel::SortByKey(codes, order, MORTON_BITS);
+
+            nodes_.resize(2 * count - 1);
+            parents_.assign(2 * count - 1, NONE);
+            parallel::For(count, parallel::DEFAULT_GRAIN * 16, [&](size_t begin, size_t end, size_t) {
+                for (size_t k = begin; k < end; ++k) {
+                    auto &leaf = nodes_[count - 1 + k];
+                    leaf.box = bounds_[order[k]];
+                    leaf.left = order[k];
+                    leaf.right = NONE;
+                }
+            });
+
+            parallel::For(count - 1, parallel::DEFAULT_GRAIN * 16, [&](size_t begin, size_t end, size_t) {
+                for (size_t i = begin; i < end; ++i)
+                    BuildInternal(codes, static_cast<int64_t>(i));
+            });
+
+            ComputeBounds(count);
+        }
+
+        const AABB &GetBounds(size_t index) const {
+            return bounds_[index];
+        }
+
+        size_t GetSize() const {
+            return bounds_.size();
+        }
+
+        // Calls 'func(index)' for every stored item whose bounds overlap 'box'.
+        template <typename FuncT>
+        void Query(const AABB &box, FuncT &&func) const {
+            if (nodes_.empty())
+                return;
+
+            size_t first_leaf = bounds_.size() - 1;
+            std::array<uint32_t, MAX_DEPTH> stack;
+            size_t top = 0;
+            stack[top++] = 0;
+
+            while (top > 0) {
+                uint32_t index = stack[--top];
+                const auto &node = nodes_[index];
+                if (!Overlaps(node.box, box))
+                    continue;
+
+                if (index >= first_leaf) {
+                    func(static_cast<size_t>(node.left));
+                } else {
+                    stack[top++] = node.right;
+                    stack[top++] = node.left;
+                }
+            }
+        }
+
+    private:
+        static constexpr uint32_t NONE = std::numeric_limits<uint32_t>::max();
+        // Every level of the radix tree extends the common prefix of the 63-bit code
+        // and 32-bit index pair by at least one bit.
+        static constexpr size_t MAX_DEPTH = 128U;
+
+        struct Node {
+            AABB box;
+            uint32_t left;  // child node, or the triangle index for a leaf
+            uint32_t right; // child node, NONE for a leaf
+        };
+
+        // Length of the common prefix of keys 'i' and 'j'; equal codes are told apart by their index.
+        static int GetPrefix(const std::vector<uint64_t> &codes, int64_t i, int64_t j) {
+            if (j < 0 || j >= static_cast<int64_t>(codes.size()))
+                return -1;
+            if (codes[i] == codes[j])
+                return 64 + std::countl_zero(static_cast<uint32_t>(i ^ j));
+            return std::countl_zero(codes[i] ^ codes[j]);
+        }
+
+        void BuildInternal(const std::vector<uint64_t> &codes, int64_t i) {
+            int64_t dir = (GetPrefix(codes, i, i + 1) - GetPrefix(codes, i, i - 1) >= 0) ? 1 : -1;
+            int min_prefix = GetPrefix(codes, i, i - dir);
+
+            int64_t max_length = 2;
+            while (GetPrefix(codes, i, i + max_length * dir) > min_prefix)
+                max_length *= 2;
+
+            int64_t length = 0;
+            for (int64_t step = max_length / 2; step >= 1; step /= 2)
+                if (GetPrefix(codes, i, i + (length + step) * dir) > min_prefix)
+                    length += step;
+
+            int64_t j = i + length * dir;
+            int node_prefix = GetPrefix(codes, i, j);
+
+            int64_t split = 0;
+            for (int64_t div = 2;; div *= 2) {
+                int64_t step = (length + div - 1) / div;
+                if (GetPrefix(codes, i, i + (split + step) * dir) > node_prefix)
+                    split += step;
+                if (step == 1)
+                    break;
+            }
+
+            int64_t gamma = i + split * dir + std::min<int64_t>(dir, 0);
+            int64_t first_leaf = static_cast<int64_t>(codes.size()) - 1;
+            auto left = static_cast<uint32_t>((std::min(i, j) == gamma) ? first_leaf + gamma : gamma);
+            auto right = static_cast<uint32_t>((std::max(i, j) == gamma + 1) ? first_leaf + gamma + 1 : gamma + 1);
+
+            nodes_[i].left = left;
+            nodes_[i].right = right;
+            parents_[left] = static_cast<uint32_t>(i);
+            parents_[right] = static_cast<uint32_t>(i);
+        }
+
+        // Bottom-up bounds: a thread climbs from every leaf and stops at the first node whose other
+        // child is not finished yet; the thread arriving second merges the children and goes on.
+        void ComputeBounds(size_t count) {
+            std::vector<uint32_t> visits(count, 0U);
+            parallel::For(count, parallel::DEFAULT_GRAIN * 16, [&](size_t begin, size_t end, size_t) {
+                for (size_t k = begin; k < end; ++k) {
+                    uint32_t node = parents_[count - 1 + k];
+                    while (node != NONE) {
+                        if (std::atomic_ref<uint32_t>{visits[node]}.fetch_add(1, std::memory_order_acq_rel) == 0)
+                            break;
+
+                        auto &parent = nodes_[node];
+                        parent.box = Merge(nodes_[parent.left].box, nodes_[parent.right].box);
+                        node = parents_[node];
+                    }
+                }
+            });
+        }
+
+        std::vector<AABB> bounds_;
+        std::vector<Node> nodes_;
+        std::vector<uint32_t> parents_;
+    }; // class LinearOctree
+} // namespace intersection
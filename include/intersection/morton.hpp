@@ -0,0 +1,74 @@
+#pragma once
+
+#include "intersection/triangle.hpp"
+#include "parallel.hpp"
+
+#include <cstdint>
+#include <vector>
+
+namespace intersection {
+    constexpr uint32_t MORTON_AXIS_BITS = 21U;
+    constexpr uint32_t MORTON_AXIS_MAX = (1U << MORTON_AXIS_BITS) - 1;
+    constexpr size_t MORTON_BITS = 3 * MORTON_AXIS_BITS;
+
+    namespace details {
+        // Spreads the low 21 bits of 'value' so that two zero bits follow each of them.
+        inline uint64_t SpreadBits(uint64_t value) {
+            value &= MORTON_AXIS_MAX;
+            value = (value | (value << 32)) & 0x001F00000000FFFFULL;
+            value = (value | (value << 16)) & 0x001F0000FF0000FFULL;
+            value = (value | (value << 8))  & 0x100F00F00F00F00FULL;
+            value = (value | (value << 4))  & 0x10C30C30C30C30C3ULL;
+            value = (value | (value << 2))  & 0x1249249249249249ULL;
+            return value;
+        }
+
+        inline uint32_t Quantize(float value, float min, float scale) {
+            float cell = (value - min) * scale;
+            if (!(cell > 0.0f))
+                return 0;
+            return (cell >= static_cast<float>(MORTON_AXIS_MAX)) ? MORTON_AXIS_MAX : static_cast<uint32_t>(cell);
+        }
+    } // namespace details
+
+    // 63-bit Morton code, x takes the highest bit of every triple.
+    inline uint64_t EncodeMorton(uint32_t x, uint32_t y, uint32_t z) {
+        return (details::SpreadBits(x) << 2) | (details::SpreadBits(y) << 1) | details::SpreadBits(z);
+    }
+
+    // Maps 'point' inside 'box' to the 2^21 grid per axis and interleaves the cell coordinates.
+    inline uint64_t EncodeMorton(const glm::vec3 &point, const AABB &box) {
+        glm::vec3 extent = GetExtent(box);
+        float max_extent = glm::max(glm::max(extent.x, extent.y), extent.z);
+        float scale = (max_extent > 0.0f) ? static_cast<float>(MORTON_AXIS_MAX) / max_extent : 0.0f;
+
+        return EncodeMorton(details::Quantize(point.x, box.min.x, scale),
+                            details::Quantize(point.y, box.min.y, scale),
+                            details::Quantize(point.z, box.min.z, scale));
+    }
+
+    inline AABB GetCentroidBounds(const std::vector<glm::vec3> &points) {
+        size_t tri_count = GetTriangleCount(points);
+        glm::vec3 first = (tri_count > 0) ? GetCentroid(GetTriangle(points, 0)) : glm::vec3(0.0f);
+        AABB box{first, first};
+
+        for (size_t i = 1; i < tri_count; ++i) {
+            glm::vec3 centroid = GetCentroid(GetTriangle(points, i));
+            box.min = glm::min(box.min, centroid);
+            box.max = glm::max(box.max, centroid);
+        }
+
+        return box;
+    }
+
+    // Morton codes of the triangle centroids, computed in parallel.
+    inline std::vector<uint64_t> GetMortonCodes(const std::vector<glm::vec3> &points, const AABB &box) {
+        std::vector<uint64_t> codes(GetTriangleCount(points));
+        parallel::For(codes.size(), parallel::DEFAULT_GRAIN * 16, [&](size_t begin, size_t end, size_t) {
+            for (size_t i = begin; i < end; ++i)
+                codes[i] = EncodeMorton(GetCentroid(GetTriangle(points, i)), box);
+        });
+
+        return codes;
+    }
+} // namespace intersection
@@ -0,0 +1,278 @@
+#pragma once
+
+#include "intersection/triangle.hpp"
+
+#include <array>
+#include <cmath>
+#include <cstdint>
+#include <utility>
+#include <limits>
+
+namespace intersection {
+    enum class Kind : uint8_t { Point, Segment, Triangle };
+
+    constexpr size_t KIND_COUNT = 3U;
+
+    struct Segment {
+        glm::vec3 p;
+        glm::vec3 q;
+    };
+
+    namespace details {
+        inline float Snap(float value) {
+            return (glm::abs(value) <= EPSILON) ? 0.0f : value;
+        }
+
+        inline bool IsSameSide(const std::array<float, 3> &dist) {
+            return (dist[0] > 0.0f && dist[1] > 0.0f && dist[2] > 0.0f) ||
+                   (dist[0] < 0.0f && dist[1] < 0.0f && dist[2] < 0.0f);
+        }
+
+        inline bool IsZero(const std::array<float, 3> &dist) {
+            return dist[0] == 0.0f && dist[1] == 0.0f && dist[2] == 0.0f;
+        }
+
+        inline int GetDominantAxis(const glm::vec3 &vec) {
+            glm::vec3 abs = glm::abs(vec);
+            if (abs.x >= abs.y && abs.x >= abs.z)
+                return 0;
+            return (abs.y >= abs.z) ? 1 : 2;
+        }
+
+        inline glm::vec2 Project(const glm::vec3 &point, int axis) {
+            switch (axis) {
+                case 0:  return glm::vec2{point.y, point.z};
+                case 1:  return glm::vec2{point.z, point.x};
+                default: return glm::vec2{point.x, point.y};
+            }
+        }
+
+        // Same as glm::normalize(glm::cross(b - a, c - a)), spelled out to pin the operation order:
+        // the vector kernels compute normals the same way, so cached normals match these exactly.
+        inline glm::vec3 GetNormal(const Triangle &tri) {
+            glm::vec3 e1 = tri.b - tri.a;
+            glm::vec3 e2 = tri.c - tri.a;
+            glm::vec3 cross{e1.y * e2.z - e2.y * e1.z, e1.z * e2.x - e2.z * e1.x, e1.x * e2.y - e2.x * e1.y};
+            float inv = 1.0f / std::sqrt(cross.x * cross.x + cross.y * cross.y + cross.z * cross.z);
+            return cross * inv;
+        }
+
+        // Sign of the distance from 'point' to the line through 'a' and 'b', snapped to zero within EPSILON.
+        inline int GetSide2D(const glm::vec2 &a, const glm::vec2 &b, const glm::vec2 &point) {
+            float orient = (b.x - a.x) * (point.y - a.y) - (b.y - a.y) * (point.x - a.x);
+            if (glm::abs(orient) <= EPSILON * glm::length(b - a))
+                return 0;
+            return (orient > 0.0f) ? 1 : -1;
+        }
+
+        inline bool IsInBox2D(const glm::vec2 &point, const glm::vec2 &a, const glm::vec2 &b) {
+            return glm::min(a.x, b.x) - EPSILON <= point.x && point.x <= glm::max(a.x, b.x) + EPSILON &&
+                   glm::min(a.y, b.y) - EPSILON <= point.y && point.y <= glm::max(a.y, b.y) + EPSILON;
+        }
+
+        inline bool IntersectSegments2D(const glm::vec2 &p1, const glm::vec2 &p2, const glm::vec2 &q1, const glm::vec2 &q2) {
+            int s1 = GetSide2D(p1, p2, q1);
+            int s2 = GetSide2D(p1, p2, q2);
+            int s3 = GetSide2D(q1, q2, p1);
+            int s4 = GetSide2D(q1, q2, p2);
+
+            if (s1 * s2 < 0 && s3 * s4 < 0)
+                return true;
+
+            return (s1 == 0 && IsInBox2D(q1, p1, p2)) || (s2 == 0 && IsInBox2D(q2, p1, p2)) ||
+                   (s3 == 0 && IsInBox2D(p1, q1, q2)) || (s4 == 0 && IsInBox2D(p2, q1, q2));
+        }
+
+        inline bool IsInTriangle2D(const glm::vec2 &point, const glm::vec2 &a, const glm::vec2 &b, const glm::vec2 &c) {
+            int s1 = GetSide2D(a, b, point);
+            int s2 = GetSide2D(b, c, point);
+            int s3 = GetSide2D(c, a, point);
+
+            bool has_pos = (s1 > 0) || (s2 > 0) || (s3 > 0);
+            bool has_neg = (s1 < 0) || (s2 < 0) || (s3 < 0);
+            return !(has_pos && has_neg);
+        }
+
+        inline bool IntersectTriangles2D(const std::array<glm::vec2, 3> &lhs, const std::array<glm::vec2, 3> &rhs) {
+            for (size_t i = 0; i < 3; ++i)
+                for (size_t j = 0; j < 3; ++j)
+                    if (IntersectSegments2D(lhs[i], lhs[(i + 1) % 3], rhs[j], rhs[(j + 1) % 3]))
+                        return true;
+
+            return IsInTriangle2D(lhs[0], rhs[0], rhs[1], rhs[2]) || IsInTriangle2D(rhs[0], lhs[0], lhs[1], lhs[2]);
+        }
+
+        inline std::array<glm::vec2, 3> Project(const Triangle &tri, int axis) {
+            return {Project(tri.a, axis), Project(tri.b, axis), Project(tri.c, axis)};
+        }
+
+        // Interval cut on the planes' intersection line by a triangle, given the projections of its
+        // vertices onto that line and their signed distances to the other triangle's plane.
+        inline std::pair<float, float> GetLineInterval(const std::array<float, 3> &proj, const std::array<float, 3> &dist) {
+            float lo = std::numeric_limits<float>::max();
+            float hi = std::numeric_limits<float>::lowest();
+
+            for (size_t i = 0; i < 3; ++i) {
+                size_t j = (i + 1) % 3;
+                if (dist[i] == 0.0f) {
+                    lo = glm::min(lo, proj[i]);
+                    hi = glm::max(hi, proj[i]);
+                }
+                if (dist[i] * dist[j] < 0.0f) {
+                    float cross = proj[i] + (proj[j] - proj[i]) * dist[i] / (dist[i] - dist[j]);
+                    lo = glm::min(lo, cross);
+                    hi = glm::max(hi, cross);
+                }
+            }
+
+            return {lo, hi};
+        }
+    } // namespace details
+
+    inline Kind GetKind(const Triangle &tri) {
+        float longest = glm::max(glm::max(glm::length(tri.b - tri.a), glm::length(tri.c - tri.b)), glm::length(tri.a - tri.c));
+        if (longest <= EPSILON)
+            return Kind::Point;
+
+        float height = glm::length(glm::cross(tri.b - tri.a, tri.c - tri.a)) / longest;
+        return (height <= EPSILON) ? Kind::Segment : Kind::Triangle;
+    }
+
+    // A degenerate triangle collapses onto the segment between its two farthest vertices.
+    inline Segment GetSegment(const Triangle &tri) {
+        float ab = glm::length(tri.b - tri.a);
+        float bc = glm::length(tri.c - tri.b);
+        float ca = glm::length(tri.a - tri.c);
+
+        if (ab >= bc && ab >= ca)
+            return Segment{tri.a, tri.b};
+        return (bc >= ca) ? Segment{tri.b, tri.c} : Segment{tri.c, tri.a};
+    }
+
+    inline float GetDistance(const glm::vec3 &point, const Segment &seg) {
+        glm::vec3 dir = seg.q - seg.p;
+        float len2 = glm::dot(dir, dir);
+        float t = (len2 > 0.0f) ? glm::clamp(glm::dot(point - seg.p, dir) / len2, 0.0f, 1.0f) : 0.0f;
+        return glm::length(seg.p + dir * t - point);
+    }
+
+    inline float GetDistance(const Segment &lhs, const Segment &rhs) {
+        glm::vec3 d1 = lhs.q - lhs.p;
+        glm::vec3 d2 = rhs.q - rhs.p;
+        glm::vec3 r = lhs.p - rhs.p;
+        float a = glm::dot(d1, d1);
+        float e = glm::dot(d2, d2);
+        float f = glm::dot(d2, r);
+
+        if (a == 0.0f)
+            return GetDistance(lhs.p, rhs);
+        if (e == 0.0f)
+            return GetDistance(rhs.p, lhs);
+
+        float b = glm::dot(d1, d2);
+        float c = glm::dot(d1, r);
+        float denom = a * e - b * b;
+
+        float s = (denom > 0.0f) ? glm::clamp((b * f - c * e) / denom, 0.0f, 1.0f) : 0.0f;
+        float t = (b * s + f) / e;
+        if (t < 0.0f) {
+            t = 0.0f;
+            s = glm::clamp(-c / a, 0.0f, 1.0f);
+        } else if (t > 1.0f) {
+            t = 1.0f;
+            s = glm::clamp((b - c) / a, 0.0f, 1.0f);
+        }
+
+        return glm::length((lhs.p + d1 * s) - (rhs.p + d2 * t));
+    }
+
+    inline bool IntersectPointTriangle(const glm::vec3 &point, const Triangle &tri) {
+        glm::vec3 normal = details::GetNormal(tri);
+        if (glm::abs(glm::dot(normal, point - tri.a)) > EPSILON)
+            return false;
+
+        int axis = details::GetDominantAxis(normal);
+        auto proj = details::Project(tri, axis);
+        return details::IsInTriangle2D(details::Project(point, axis), proj[0], proj[1], proj[2]);
+    }
+
+    inline bool IntersectSegmentTriangle(const Segment &seg, const Triangle &tri) {
+        glm::vec3 normal = details::GetNormal(tri);
+        float dp = details::Snap(glm::dot(normal, seg.p - tri.a));
+        float dq = details::Snap(glm::dot(normal, seg.q - tri.a));
+        if (dp * dq > 0.0f)
+            return false;
+
+        int axis = details::GetDominantAxis(normal);
+        auto proj = details::Project(tri, axis);
+
+        if (dp == 0.0f && dq == 0.0f) {
+            glm::vec2 p = details::Project(seg.p, axis);
+            glm::vec2 q = details::Project(seg.q, axis);
+
+            return details::IsInTriangle2D(p, proj[0], proj[1], proj[2]) ||
+                   details::IntersectSegments2D(p, q, proj[0], proj[1]) ||
+                   details::IntersectSegments2D(p, q, proj[1], proj[2]) ||
+                   details::IntersectSegments2D(p, q, proj[2], proj[0]);
+        }
+
+        glm::vec3 hit = seg.p + (seg.q - seg.p) * (dp / (dp - dq));
+        return details::IsInTriangle2D(details::Project(hit, axis), proj[0], proj[1], proj[2]);
+    }
+
+    // Triangle test with normals already computed by details::GetNormal or GetNormals().
+    inline bool IntersectTriangles(const Triangle &lhs, const glm::vec3 &lhs_normal, const Triangle &rhs, const glm::vec3 &rhs_normal) {
+
+        std::array<float, 3> lhs_dist = {details::Snap(glm::dot(rhs_normal, lhs.a - rhs.a)),
+                                         details::Snap(glm::dot(rhs_normal, lhs.b - rhs.a)),
+                                         details::Snap(glm::dot(rhs_normal, lhs.c - rhs.a))};
+        if (details::IsSameSide(lhs_dist))
+            return false;
+
+        std::array<float, 3> rhs_dist = {details::Snap(glm::dot(lhs_normal, rhs.a - lhs.a)),
+                                         details::Snap(glm::dot(lhs_normal, rhs.b - lhs.a)),
+                                         details::Snap(glm::dot(lhs_normal, rhs.c - lhs.a))};
+        if (details::IsSameSide(rhs_dist))
+            return false;
+
+        if (details::IsZero(lhs_dist) || details::IsZero(rhs_dist)) {
+            int axis = details::GetDominantAxis(lhs_normal);
+            return details::IntersectTriangles2D(details::Project(lhs, axis), details::Project(rhs, axis));
+        }
+
+        int axis = details::GetDominantAxis(glm::cross(lhs_normal, rhs_normal));
+        auto [lhs_lo, lhs_hi] = details::GetLineInterval({lhs.a[axis], lhs.b[axis], lhs.c[axis]}, lhs_dist);
+        auto [rhs_lo, rhs_hi] = details::GetLineInterval({rhs.a[axis], rhs.b[axis], rhs.c[axis]}, rhs_dist);
+
+        return lhs_lo <= rhs_hi + EPSILON && rhs_lo <= lhs_hi + EPSILON;
+    }
+
+    inline bool IntersectTriangles(const Triangle &lhs, const Triangle &rhs) {
+        return IntersectTriangles(lhs, details::GetNormal(lhs), rhs, details::GetNormal(rhs));
+    }
+
+    // Intersection of figures whose kinds are already known.
+    inline bool Intersect(const Triangle &lhs, Kind lhs_kind, const Triangle &rhs, Kind rhs_kind) {
+        if (lhs_kind < rhs_kind)
+            return Intersect(rhs, rhs_kind, lhs, lhs_kind);
+
+        switch (lhs_kind) {
+            case Kind::Triangle:
+                if (rhs_kind == Kind::Triangle)
+                    return IntersectTriangles(lhs, rhs);
+                if (rhs_kind == Kind::Segment)
+                    return IntersectSegmentTriangle(GetSegment(rhs), lhs);
+                return IntersectPointTriangle(rhs.a, lhs);
+            case Kind::Segment:
+                if (rhs_kind == Kind::Segment)
+                    return GetDistance(GetSegment(lhs), GetSegment(rhs)) <= EPSILON;
+                return GetDistance(rhs.a, GetSegment(lhs)) <= EPSILON;
+            default:
+                return glm::length(lhs.a - rhs.a) <= EPSILON;
+        }
+    }
+
+    inline bool Intersect(const Triangle &lhs, const Triangle &rhs) {
+        return Intersect(lhs, GetKind(lhs), rhs, GetKind(rhs));
+    }
+} // namespace intersection
@@ -0,0 +1,201 @@
+#pragma once
+
+#include "intersection/triangle.hpp"
+
+#include <algorithm>
+#include <array>
+#include <memory>
+#include <vector>
+
+namespace intersection {
+    constexpr size_t OCTREE_MAX_DEPTH = 10U;
+    constexpr size_t OCTREE_LEAF_CAPACITY = 8U;
+
+    struct OctreeParams {
+        size_t max_depth = OCTREE_MAX_DEPTH;
+        size_t leaf_capacity = OCTREE_LEAF_CAPACITY;
+        float looseness = 1.0f; // 1 is a classic octree, loose octrees usually take 2
+    };
+
+    struct OctreeLevelStats {
+        size_t node_count = 0;
+        size_t item_count = 0;
+        size_t max_items = 0; // most items held by one node of the level
+    };
+
+    // An item lives in the deepest node whose loose cell fully contains its bounds. A loose cell is
+    // the node's cell scaled by 'looseness' around its center. With looseness 1 this is the classic
+    // octree, where items that cross a split plane stay in the parent; with a bigger factor they sink
+    // to the child holding their center as long as they are not much bigger than that child.
+    class Octree final {
+    public:
+        Octree(std::vector<AABB> bounds, const OctreeParams &params = {})
+            : bounds_(std::move(bounds)), params_(params) {
+            params_.looseness = glm::max(params_.looseness, 1.0f);
+            if (bounds_.empty())
+                return;
+
+            AABB scene = bounds_.front();
+            for (const auto &box : bounds_)
+                scene = Merge(scene, box);
+
+            glm::vec3 center = GetCenter(scene);
+            float half = glm::max(glm::max(GetExtent(scene).x, GetExtent(scene).y), GetExtent(scene).z) * 0.5f + EPSILON;
+            root_ = MakeNode(AABB{center - glm::vec3(half), center + glm::vec3(half)});
+
+            location_.resize(bounds_.size(), nullptr);
+            for (size_t i = 0; i < bounds_.size(); ++i)
+                Insert(*root_, static_cast<uint32_t>(i), 0);
+        }
+
+        // Moves an item to new bounds: it is unlinked from its node and inserted again from the root.
+        // Items that leave the root cell are kept in the root, which is never pruned by queries.
+        void Update(size_t index, const AABB &box) {
+            Remove(index);
+            bounds_[index] = box;
+
+            if (Contains(root_->loose, box)) {
+                Insert(*root_, static_cast<uint32_t>(index), 0);
+            } else {
+                root_->items.push_back(static_cast<uint32_t>(index));
+                location_[index] = root_.get();
+            }
+        }
+
+        const AABB &GetBounds(size_t index) const {
+            return bounds_[index];
+        }
+
+        size_t GetSize() const {
+            return bounds_.size();
+        }
+
+        // Calls 'func(index)' for every stored item whose bounds overlap 'box'.
+        template <typename FuncT>
+        void Query(const AABB &box, FuncT &&func) const {
+            if (root_)
+                Query(*root_, box, func);
+        }
+
+        // Node and item counts per depth, the root is level 0.
+        std::vector<OctreeLevelStats> GetLevelStats() const {
+            std::vector<OctreeLevelStats> levels;
+            if (root_)
+                CollectStats(*root_, 0, levels);
+            return levels;
+        }
+
+    private:
+        struct Node {
+            Node(const AABB &cell, const AABB &loose) : cell(cell), loose(loose) {}
+
+            bool IsLeaf() const {
+                return children[0] == nullptr;
+            }
+
+            AABB cell;
+            AABB loose;
+            std::vector<uint32_t> items;
+            std::array<std::unique_ptr<Node>, 8> children;
+        };
+
+        std::unique_ptr<Node> MakeNode(const AABB &cell) const {
+            glm::vec3 center = GetCenter(cell);
+            glm::vec3 half = GetExtent(cell) * (0.5f * params_.looseness);
+            return std::make_unique<Node>(cell, AABB{center - half, center + half});
+        }
+
+        static AABB GetOctant(const AABB &cell, size_t octant) {
+            glm::vec3 center = GetCenter(cell);
+            AABB child = cell;
+            for (int axis = 0; axis < 3; ++axis) {
+                if (octant & (1U << axis))
+                    child.min[axis] = center[axis];
+                else
+                    child.max[axis] = center[axis];
+            }
+            return child;
+        }
+
+        // Child that takes 'box': the octant of its center, if the child's loose cell holds it whole.
+        static int FindOctant(const Node &node, const AABB &box) {
+            glm::vec3 center = GetCenter(node.cell);
+            glm::vec3 box_center = GetCenter(box);
+            int octant = 0;
+            for (int axis = 0; axis < 3; ++axis)
+                if (box_center[axis] >= center[axis])
+                    octant |= (1 << axis);
+
+            return Contains(node.children[octant]->loose, box) ? octant : -1;
+        }
+
+        void Insert(Node &node, uint32_t index, size_t depth) {
+            if (!node.IsLeaf()) {
+                int octant = FindOctant(node, bounds_[index]);
+                if (octant >= 0) {
+                    Insert(*node.children[octant], index, depth + 1);
+                } else {
+                    node.items.push_back(index);
+                    location_[index] = &node;
+                }
+                return;
+            }
+
+            node.items.push_back(index);
+            location_[index] = &node;
+            if (node.items.size() > params_.leaf_capacity && depth < params_.max_depth)
+                Split(node, depth);
+        }
+
+        void Split(Node &node, size_t depth) {
+            for (size_t i = 0; i < 8; ++i)
+                node.children[i] = MakeNode(GetOctant(node.cell, i));
+
+            std::vector<uint32_t> items;
+            items.swap(node.items);
+            for (auto index : items)
+                Insert(node, index, depth);
+        }
+
+        void Remove(size_t index) {
+            auto &items = location_[index]->items;
+            auto it = std::find(items.begin(), items.end(), static_cast<uint32_t>(index));
+            *it = items.back();
+            items.pop_back();
+            location_[index] = nullptr;
+        }
+
+        template <typename FuncT>
+        void Query(const Node &node, const AABB &box, FuncT &func) const {
+            for (auto index : node.items)
+                if (Overlaps(bounds_[index], box))
+                    func(static_cast<size_t>(index));
+
+            if (node.IsLeaf())
+                return;
+
+            for (const auto &child : node.children)
+                if (Overlaps(child->loose, box))
+                    Query(*child, box, func);
+        }
+
+        static void CollectStats(const Node &node, size_t depth, std::vector<OctreeLevelStats> &levels) {
+            if (levels.size() <= depth)
+                levels.resize(depth + 1);
+
+            auto &level = levels[depth];
+            ++level.node_count;
+            level.item_count += node.items.size();
+            level.max_items = std::max(level.max_items, node.items.size());
+
+            if (!node.IsLeaf())
+                for (const auto &child : node.children)
+                    CollectStats(*child, depth + 1, levels);
+        }
+
+        std::vector<AABB> bounds_;
+        OctreeParams params_;
+        std::unique_ptr<Node> root_;
+        std::vector<Node *> location_;
+    }; // class Octree
+} // namespace intersection
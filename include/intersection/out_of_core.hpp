@@ -0,0 +1,277 @@
+#pragma once
+
+#include "intersection/intersector.hpp"
+
+#include <algorithm>
+#include <array>
+#include <cmath>
+#include <filesystem>
+#include <fstream>
+#include <istream>
+#include <numeric>
+#include <random>
+#include <stdexcept>
+#include <string>
+
+namespace intersection {
+    namespace fs = std::filesystem;
+
+    constexpr size_t OUT_OF_CORE_DEFAULT_BUDGET = size_t{1} << 30;
+    // Rough in-memory cost of one triangle while its tile is intersected:
+    // points, bounds, octree slot, traversal order and the original index.
+    constexpr size_t OUT_OF_CORE_TRIANGLE_FOOTPRINT = 128U;
+    constexpr size_t OUT_OF_CORE_MAX_GRID = 8U;
+    constexpr size_t OUT_OF_CORE_MAX_DEPTH = 4U;
+    constexpr size_t OUT_OF_CORE_MAX_COPIES = 8U; // records over all tiles per input triangle
+
+    struct OutOfCoreOptions {
+        size_t memory_budget = OUT_OF_CORE_DEFAULT_BUDGET; // bytes available to one tile
+        fs::path temp_dir = fs::temp_directory_path();
+    };
+
+    struct OutOfCoreStats {
+        size_t triangle_count = 0;
+        size_t tile_count = 0;
+        size_t record_count = 0; // triangles over all tiles, a straddling triangle counts once per tile
+        size_t max_tile_size = 0;
+    };
+
+    // Intersects scenes that do not fit into memory. The input is spooled to disk, split spatially
+    // into tiles and every tile is intersected on its own; only the per-triangle flags stay in memory.
+    //
+    // A triangle is written to every tile its bounds touch. A pair is tested only in the tile that holds
+    // the minimum corner of the overlap of the two bounds, so pairs shared by several tiles are tested once.
+    class OutOfCoreIntersector final {
+    public:
+        explicit OutOfCoreIntersector(const OutOfCoreOptions &options = {}) : options_(options) {
+            if (options_.memory_budget < OUT_OF_CORE_TRIANGLE_FOOTPRINT)
+                throw std::invalid_argument("Out-of-core memory budget is too small");
+
+            std::random_device device;
+            work_dir_ = options_.temp_dir / ("triangles-" + std::to_string(device()));
+            fs::create_directories(work_dir_);
+        }
+
+        OutOfCoreIntersector(const OutOfCoreIntersector &other) = delete;
+        OutOfCoreIntersector &operator=(const OutOfCoreIntersector &other) = delete;
+
+        ~OutOfCoreIntersector() {
+            std::error_code error;
+            fs::remove_all(work_dir_, error);
+        }
+
+        // Reads a scene in the TriangleScene text format and returns the flags in input order.
+        Bitset Run(std::istream &input) {
+            size_t fig_count = 0;
+            input >> fig_count;
+            if (!input.good())
+                throw std::runtime_error("Input is failed when reading figure count");
+
+            stats_ = OutOfCoreStats{};
+            copied_ = 0;
+            stats_.triangle_count = fig_count;
+
+            fs::path spool = work_dir_ / "input.bin";
+            Cell root{Spool(input, spool, fig_count), {true, true, true}};
+
+            Bitset flags{fig_count};
+            if (fig_count > 0)
+                ProcessCell(spool, fig_count, root, 0, flags);
+            return flags;
+        }
+
+        const OutOfCoreStats &GetStats() const {
+            return stats_;
+        }
+
+    private:
+        struct Record {
+            uint64_t index;
+            glm::vec3 points[3];
+        };
+
+        // Split planes of a cell, 'dims[axis]' tiles along every axis.
+        struct Grid {
+            std::array<size_t, 3> dims;
+            std::array<std::vector<float>, 3> planes;
+
+            // Calls 'func(tile)' for every tile the bounds of 'record' touch.
+            template <typename FuncT>
+            void ForEachTile(const Record &record, FuncT &&func) const {
+                AABB box = GetBounds(Triangle{record.points[0], record.points[1], record.points[2]});
+                std::array<size_t, 3> lo, hi;
+                for (int axis = 0; axis < 3; ++axis) {
+                    lo[axis] = 0;
+                    while (lo[axis] + 1 < dims[axis] && planes[axis][lo[axis] + 1] <= box.min[axis] - EPSILON)
+                        ++lo[axis];
+                    hi[axis] = dims[axis] - 1;
+                    while (hi[axis] > 0 && planes[axis][hi[axis]] > box.max[axis] + EPSILON)
+                        --hi[axis];
+                }
+
+                for (size_t x = lo[0]; x <= hi[0]; ++x)
+                    for (size_t y = lo[1]; y <= hi[1]; ++y)
+                        for (size_t z = lo[2]; z <= hi[2]; ++z)
+                            func((x * dims[1] + y) * dims[2] + z);
+            }
+        };
+
+        // A tile's cell is half-open on its upper faces, except where it touches the scene's upper faces.
+        struct Cell {
+            AABB box;
+            std::array<bool, 3> closed;
+        };
+
+        AABB Spool(std::istream &input, const fs::path &path, size_t fig_count) {
+            std::ofstream out{path, std::ios::binary};
+            AABB scene{glm::vec3(0.0f), glm::vec3(0.0f)};
+
+            for (size_t i = 0; i < fig_count; ++i) {
+                Record record{i, {}};
+                for (auto &point : record.points) {
+                    input >> point.x >> point.y >> point.z;
+                    if (input.fail())
+                        throw std::runtime_error("Input is failed when reading coordinates");
+                }
+
+                AABB box = GetBounds(Triangle{record.points[0], record.points[1], record.points[2]});
+                scene = (i == 0) ? box : Merge(scene, box);
+                Write(out, record);
+            }
+
+            return scene;
+        }
+
+        void ProcessCell(const fs::path &path, size_t count, const Cell &cell, size_t depth, Bitset &flags) {
+            if (count * OUT_OF_CORE_TRIANGLE_FOOTPRINT <= options_.memory_budget || depth >= OUT_OF_CORE_MAX_DEPTH) {
+                IntersectTile(path, count, cell, flags);
+                fs::remove(path);
+                return;
+            }
+
+            size_t needed = (count * OUT_OF_CORE_TRIANGLE_FOOTPRINT + options_.memory_budget - 1) / options_.memory_budget;
+            size_t grid = static_cast<size_t>(std::ceil(std::cbrt(static_cast<double>(needed))));
+            grid = std::clamp<size_t>(grid, 2, OUT_OF_CORE_MAX_GRID);
+
+            // Flat axes are not split, every tile would get the whole cell anyway.
+            Grid split;
+            for (int axis = 0; axis < 3; ++axis) {
+                float extent = cell.box.max[axis] - cell.box.min[axis];
+                split.dims[axis] = (extent > EPSILON) ? grid : 1;
+                for (size_t k = 0; k < split.dims[axis]; ++k)
+                    split.planes[axis].push_back(cell.box.min[axis] + extent * k / split.dims[axis]);
+                split.planes[axis].push_back(cell.box.max[axis]);
+            }
+
+            size_t tile_count = split.dims[0] * split.dims[1] * split.dims[2];
+            std::vector<size_t> counts(tile_count, 0U);
+            ForEachRecord(path, count, [&](const Record &record) {
+                split.ForEachTile(record, [&](size_t t) { ++counts[t]; });
+            });
+
+            // A triangle spanning the cell goes to every tile, so a split of long slivers makes no tile
+            // smaller and would copy them again at every level. Such cells are intersected as they are,
+            // and so is every cell once the copies would exceed OUT_OF_CORE_MAX_COPIES times the input.
+            size_t total = std::accumulate(counts.begin(), counts.end(), size_t{0});
+            size_t largest = *std::max_element(counts.begin(), counts.end());
+            if (largest >= count || copied_ + total > OUT_OF_CORE_MAX_COPIES * stats_.triangle_count) {
+                IntersectTile(path, count, cell, flags);
+                fs::remove(path);
+                return;
+            }
+            copied_ += total;
+
+            {
+                std::vector<std::ofstream> outs(tile_count);
+                for (size_t t = 0; t < tile_count; ++t)
+                    outs[t].open(GetTilePath(path, t), std::ios::binary);
+                ForEachRecord(path, count, [&](const Record &record) {
+                    split.ForEachTile(record, [&](size_t t) { Write(outs[t], record); });
+                });
+            }
+            fs::remove(path);
+
+            for (size_t x = 0; x < split.dims[0]; ++x)
+                for (size_t y = 0; y < split.dims[1]; ++y)
+                    for (size_t z = 0; z < split.dims[2]; ++z) {
+                        std::array<size_t, 3> k = {x, y, z};
+                        Cell sub = cell;
+                        for (int axis = 0; axis < 3; ++axis) {
+                            sub.box.min[axis] = split.planes[axis][k[axis]];
+                            sub.box.max[axis] = split.planes[axis][k[axis] + 1];
+                            sub.closed[axis] = cell.closed[axis] && (k[axis] + 1 == split.dims[axis]);
+                        }
+
+                        size_t t = (x * split.dims[1] + y) * split.dims[2] + z;
+                        if (counts[t] > 0)
+                            ProcessCell(GetTilePath(path, t), counts[t], sub, depth + 1, flags);
+                        else
+                            fs::remove(GetTilePath(path, t));
+                    }
+        }
+
+        template <typename FuncT>
+        static void ForEachRecord(const fs::path &path, size_t count, FuncT &&func) {
+            std::ifstream in{path, std::ios::binary};
+            Record record;
+            for (size_t r = 0; r < count && Read(in, record); ++r)
+                func(record);
+        }
+
+        void IntersectTile(const fs::path &path, size_t count, const Cell &cell, Bitset &flags) {
+            std::vector<uint64_t> ids;
+            std::vector<glm::vec3> points;
+            ids.reserve(count);
+            points.reserve(3 * count);
+
+            std::ifstream in{path, std::ios::binary};
+            Record record;
+            for (size_t r = 0; r < count && Read(in, record); ++r) {
+                ids.push_back(record.index);
+                points.insert(points.end(), std::begin(record.points), std::end(record.points));
+            }
+
+            ++stats_.tile_count;
+            stats_.record_count += ids.size();
+            stats_.max_tile_size = std::max(stats_.max_tile_size, ids.size());
+
+            Octree octree{GetBounds(points)};
+            auto owns_pair = [&octree, &cell](uint32_t i, uint32_t j) {
+                glm::vec3 reference = glm::max(octree.GetBounds(i).min, octree.GetBounds(j).min);
+                for (int axis = 0; axis < 3; ++axis) {
+                    if (reference[axis] < cell.box.min[axis] || reference[axis] > cell.box.max[axis])
+                        return false;
+                    if (reference[axis] == cell.box.max[axis] && !cell.closed[axis])
+                        return false;
+                }
+                return true;
+            };
+
+            auto &&result = Intersect(points, octree, Options{}, owns_pair);
+            for (size_t k = 0; k < ids.size(); ++k)
+                if (result.flags[k])
+                    flags.Set(ids[k]);
+        }
+
+        static fs::path GetTilePath(const fs::path &parent, size_t tile) {
+            fs::path path = parent;
+            path.replace_extension(std::to_string(tile) + ".bin");
+            return path;
+        }
+
+        static void Write(std::ofstream &out, const Record &record) {
+            out.write(reinterpret_cast<const char *>(&record), sizeof(Record));
+            if (!out.good())
+                throw std::runtime_error("Failed to write an out-of-core tile");
+        }
+
+        static bool Read(std::ifstream &in, Record &record) {
+            return static_cast<bool>(in.read(reinterpret_cast<char *>(&record), sizeof(Record)));
+        }
+
+        OutOfCoreOptions options_;
+        OutOfCoreStats stats_;
+        size_t copied_ = 0; // records written to tiles by all splits of the current run
+        fs::path work_dir_;
+    }; // class OutOfCoreIntersector
+} // namespace intersection
@@ -0,0 +1,243 @@
+#pragma once
+
+#include "intersection/intersector.hpp"
+
+#include <algorithm>
+#include <bit>
+#include <cmath>
+#include <format>
+#include <ostream>
+#include <random>
+#include <string>
+#include <utility>
+#include <vector>
+
+namespace intersection {
+    constexpr size_t PLANNER_SAMPLE_SIZE = 4096U;
+    constexpr size_t PLANNER_PAIR_SAMPLE_SIZE = 2048U;
+    constexpr size_t PLANNER_NARROW_SAMPLE_SIZE = 256U;
+    constexpr size_t PLANNER_HISTOGRAM_CELLS = 16U;
+    constexpr size_t PLANNER_SMALL_SCENE = 8192U;
+    constexpr size_t PLANNER_MIN_LEAF_CAPACITY = OCTREE_LEAF_CAPACITY;
+    constexpr size_t PLANNER_MAX_LEAF_CAPACITY = 4 * OCTREE_LEAF_CAPACITY;
+    constexpr float PLANNER_HEAVY_TAIL = 8.0f;       // p90 / median extent above which sizes count as heavy-tailed
+    constexpr float PLANNER_STUCK_FRACTION = 0.25f;  // share of triangles held far above their size level
+    constexpr float PLANNER_CLUSTERED = 8.0f;        // fullest histogram cell / mean occupied cell
+    constexpr uint32_t PLANNER_SEED = 0x5EEDU;
+
+    // Scene statistics gathered on a sample and the options chosen from them.
+    struct Plan {
+        Options options;
+        size_t tri_count = 0;
+        size_t sample_count = 0;
+        float median_extent = 0.0f; // triangle extents relative to the scene size
+        float p90_extent = 0.0f;
+        float max_extent = 0.0f;
+        float stuck_fraction = 0.0f; // triangles a classic octree would keep 3+ levels above their size level
+        float occupied_cells = 0.0f; // share of histogram cells holding a sampled centroid
+        float peak_density = 0.0f;   // fullest histogram cell / mean occupied cell
+        double candidate_pairs = 0.0;
+        double intersecting_pairs = 0.0;
+        std::string reason;
+    };
+
+    namespace details {
+        inline std::vector<uint32_t> SampleTriangles(size_t tri_count, size_t sample_count, std::mt19937 &rng) {
+            std::vector<uint32_t> sample;
+            if (tri_count <= sample_count) {
+                sample.resize(tri_count);
+                std::iota(sample.begin(), sample.end(), 0U);
+                return sample;
+            }
+
+            std::uniform_int_distribution<uint32_t> pick(0, static_cast<uint32_t>(tri_count - 1));
+            sample.reserve(sample_count);
+            for (size_t i = 0; i < sample_count; ++i)
+                sample.push_back(pick(rng));
+            return sample;
+        }
+
+        inline float GetLongestSide(const AABB &box) {
+            glm::vec3 extent = GetExtent(box);
+            return glm::max(glm::max(extent.x, extent.y), extent.z);
+        }
+
+        // Depth at which a classic octree over 'scene' stores 'box': it stops at the first split plane it crosses.
+        inline size_t GetClassicDepth(AABB cell, const AABB &box, size_t max_depth) {
+            size_t depth = 0;
+            for (; depth < max_depth; ++depth) {
+                glm::vec3 center = GetCenter(cell);
+                for (int axis = 0; axis < 3; ++axis) {
+                    if (box.min[axis] >= center[axis])
+                        cell.min[axis] = center[axis];
+                    else if (box.max[axis] <= center[axis])
+                        cell.max[axis] = center[axis];
+                    else
+                        return depth;
+                }
+            }
+            return depth;
+        }
+
+        inline size_t GetSizeDepth(float scene_size, float extent) {
+            if (extent <= 0.0f)
+                return OCTREE_MAX_DEPTH;
+            return static_cast<size_t>(glm::max(std::floor(std::log2(scene_size / extent)), 0.0f));
+        }
+    } // namespace details
+
+    // Samples the scene and picks the broad phase and its parameters. 'options.mode' and the other
+    // caller settings are kept, only the broad-phase fields are overwritten.
+    inline Plan MakePlan(const std::vector<glm::vec3> &points, const Options &options = {}) {
+        Plan plan;
+        plan.options = options;
+        plan.tri_count = GetTriangleCount(points);
+        if (plan.tri_count == 0) {
+            plan.reason = "empty scene";
+            return plan;
+        }
+
+        std::mt19937 rng{PLANNER_SEED};
+        auto sample = details::SampleTriangles(plan.tri_count, PLANNER_SAMPLE_SIZE, rng);
+        plan.sample_count = sample.size();
+
+        AABB scene = GetBounds(GetTriangle(points, 0));
+        for (size_t i = 1; i < plan.tri_count; ++i)
+            scene = Merge(scene, GetBounds(GetTriangle(points, i)));
+        float scene_size = glm::max(details::GetLongestSide(scene), EPSILON);
+        AABB root{GetCenter(scene) - glm::vec3(scene_size * 0.5f), GetCenter(scene) + glm::vec3(scene_size * 0.5f)};
+
+        // Triangle extents and how many triangles a classic octree would strand near the root.
+        std::vector<float> extents;
+        extents.reserve(sample.size());
+        size_t stuck = 0;
+        for (auto index : sample) {
+            AABB box = GetBounds(GetTriangle(points, index));
+            float extent = details::GetLongestSide(box);
+            extents.push_back(extent / scene_size);
+
+            size_t size_depth = std::min(details::GetSizeDepth(scene_size, extent), OCTREE_MAX_DEPTH);
+            if (details::GetClassicDepth(root, box, size_depth) + 3 <= size_depth)
+                ++stuck;
+        }
+
+        std::sort(extents.begin(), extents.end());
+        plan.median_extent = extents[extents.size() / 2];
+        plan.p90_extent = extents[extents.size() * 9 / 10];
+        plan.max_extent = extents.back();
+        plan.stuck_fraction = static_cast<float>(stuck) / sample.size();
+
+        // Spatial density histogram of the sampled centroids.
+        constexpr size_t cells = PLANNER_HISTOGRAM_CELLS;
+        std::vector<uint32_t> histogram(cells * cells * cells, 0U);
+        for (auto index : sample) {
+            glm::vec3 rel = (GetCentroid(GetTriangle(points, index)) - root.min) * (static_cast<float>(cells) / scene_size);
+            size_t x = std::min(static_cast<size_t>(glm::max(rel.x, 0.0f)), cells - 1);
+            size_t y = std::min(static_cast<size_t>(glm::max(rel.y, 0.0f)), cells - 1);
+            size_t z = std::min(static_cast<size_t>(glm::max(rel.z, 0.0f)), cells - 1);
+            ++histogram[(x * cells + y) * cells + z];
+        }
+
+        size_t occupied = std::count_if(histogram.begin(), histogram.end(), [](uint32_t count) { return count > 0; });
+        uint32_t peak = *std::max_element(histogram.begin(), histogram.end());
+        plan.occupied_cells = static_cast<float>(occupied) / histogram.size();
+        plan.peak_density = peak * static_cast<float>(occupied) / sample.size();
+
+        // Candidate and intersecting pair counts on a random subset, scaled to the whole scene.
+        auto subset = details::SampleTriangles(plan.tri_count, PLANNER_PAIR_SAMPLE_SIZE, rng);
+        std::sort(subset.begin(), subset.end());
+        subset.erase(std::unique(subset.begin(), subset.end()), subset.end());
+
+        std::vector<glm::vec3> subset_points;
+        subset_points.reserve(3 * subset.size());
+        for (auto index : subset) {
+            Triangle tri = GetTriangle(points, index);
+            subset_points.insert(subset_points.end(), {tri.a, tri.b, tri.c});
+        }
+
+        // The narrow-phase sample is a reservoir over all candidates: the first ones in traversal
+        // order come from one corner of the scene and would bias the intersecting fraction.
+        LinearOctree subset_tree{subset_points};
+        std::vector<std::pair<uint32_t, uint32_t>> reservoir;
+        reservoir.reserve(PLANNER_NARROW_SAMPLE_SIZE);
+        size_t candidates = 0;
+        for (size_t i = 0; i < subset.size(); ++i) {
+            subset_tree.Query(subset_tree.GetBounds(i), [&](size_t j) {
+                if (j <= i)
+                    return;
+
+                std::pair pair{static_cast<uint32_t>(i), static_cast<uint32_t>(j)};
+                if (reservoir.size() < PLANNER_NARROW_SAMPLE_SIZE) {
+                    reservoir.push_back(pair);
+                } else {
+                    size_t slot = std::uniform_int_distribution<size_t>{0, candidates}(rng);
+                    if (slot < PLANNER_NARROW_SAMPLE_SIZE)
+                        reservoir[slot] = pair;
+                }
+                ++candidates;
+            });
+        }
+
+        size_t hits = 0;
+        for (auto [i, j] : reservoir)
+            hits += Intersect(GetTriangle(subset_points, i), GetTriangle(subset_points, j));
+
+        double scale = (subset.size() > 1)
+            ? static_cast<double>(plan.tri_count) * (plan.tri_count - 1) / (static_cast<double>(subset.size()) * (subset.size() - 1))
+            : 0.0;
+        plan.candidate_pairs = candidates * scale;
+        plan.intersecting_pairs = reservoir.empty() ? 0.0 : plan.candidate_pairs * hits / reservoir.size();
+
+        // Decision.
+        auto &chosen = plan.options;
+        bool clustered = plan.peak_density > PLANNER_CLUSTERED;
+        bool heavy_tail = plan.p90_extent > PLANNER_HEAVY_TAIL * plan.median_extent;
+        bool stranded = plan.stuck_fraction > PLANNER_STUCK_FRACTION;
+
+        // A triangle is tested against the neighbours its bounds overlap however finely the leaves
+        // split, so leaves about twice that full cost no extra tests and save nodes.
+        size_t depth = details::GetSizeDepth(1.0f, plan.median_extent) + 1;
+        double neighbours = 2.0 * plan.candidate_pairs / plan.tri_count;
+        chosen.octree.max_depth = std::clamp<size_t>(depth + (clustered ? 2 : 0), 4, 20);
+        chosen.octree.leaf_capacity = std::clamp(std::bit_ceil(static_cast<size_t>(std::ceil(2.0 * neighbours))),
+                                                 PLANNER_MIN_LEAF_CAPACITY, PLANNER_MAX_LEAF_CAPACITY);
+        chosen.octree.looseness = stranded ? 2.0f : 1.0f;
+
+        if (plan.tri_count <= PLANNER_SMALL_SCENE) {
+            chosen.broad_phase = BroadPhase::Octree;
+            plan.reason = "small scene, the octree builds faster than the radix sort pays off";
+        } else if (heavy_tail) {
+            chosen.broad_phase = BroadPhase::Octree;
+            chosen.octree.looseness = 2.0f;
+            plan.reason = "heavy-tailed triangle sizes, big triangles stay high in a loose octree "
+                          "instead of inflating the bounds of a Morton hierarchy";
+        } else {
+            chosen.broad_phase = BroadPhase::LinearOctree;
+            plan.reason = "large scene with even triangle sizes, the parallel Morton build wins";
+        }
+
+        if (stranded && chosen.broad_phase == BroadPhase::Octree)
+            plan.reason += "; loose cells because many triangles straddle split planes";
+        if (clustered)
+            plan.reason += "; clustered geometry, deeper tree";
+
+        return plan;
+    }
+
+    inline void PrintPlan(std::ostream &out, const Plan &plan) {
+        const auto &options = plan.options;
+        out << std::format("plan: {} triangles, {} sampled; extent median {:.4f} p90 {:.4f} max {:.4f} of scene; "
+                           "{:.1f}% stranded; {:.1f}% cells occupied, peak density {:.1f}; "
+                           "~{:.0f} candidate pairs, ~{:.0f} intersecting\n",
+                           plan.tri_count, plan.sample_count, plan.median_extent, plan.p90_extent, plan.max_extent,
+                           100.0f * plan.stuck_fraction, 100.0f * plan.occupied_cells, plan.peak_density,
+                           plan.candidate_pairs, plan.intersecting_pairs);
+
+        if (options.broad_phase == BroadPhase::LinearOctree) {
+            out << std::format("plan: linear octree ({})\n", plan.reason);
+        } else {
+            out << std::format("plan: octree, max depth {}, leaf capacity {}, looseness {:.1f} ({})\n",
+                               options.octree.max_depth, options.octree.leaf_capacity, options.octree.looseness, plan.reason);
+        }
+    }
+} // namespace intersection
@@ -0,0 +1,125 @@
+#pragma once
+
+#include "intersection/intersector.hpp"
+#include "intersection/morton.hpp"
+#include "parallel.hpp"
+
+#include <cstdint>
+#include <numeric>
+#include <utility>
+#include <vector>
+
+namespace intersection {
+    enum class Curve {
+        Morton, // Z-order, cheap to compute but jumps between distant cells at every power of two
+        Hilbert // every step moves to an adjacent cell, keeps neighbours closer in the order
+    };
+
+    // Triangles sorted along a space-filling curve. 'order[i]' is the input index of triangle i.
+    struct Reordering {
+        std::vector<glm::vec3> points;
+        std::vector<uint32_t> order;
+    };
+
+    namespace details {
+        // Skilling's transform: turns cell coordinates into the transposed Hilbert index, interleaving
+        // the result with x as the most significant axis gives the index itself.
+        inline uint64_t EncodeHilbert(uint32_t x, uint32_t y, uint32_t z) {
+            uint32_t axes[3] = {x, y, z};
+
+            for (uint32_t q = 1U << (MORTON_AXIS_BITS - 1); q > 1; q >>= 1) {
+                uint32_t p = q - 1;
+                for (auto &axis : axes) {
+                    if (axis & q) {
+                        axes[0] ^= p;
+                    } else {
+                        uint32_t t = (axes[0] ^ axis) & p;
+                        axes[0] ^= t;
+                        axis ^= t;
+                    }
+                }
+            }
+
+            axes[1] ^= axes[0];
+            axes[2] ^= axes[1];
+
+            uint32_t t = 0;
+            for (uint32_t q = 1U << (MORTON_AXIS_BITS - 1); q > 1; q >>= 1)
+                if (axes[2] & q)
+                    t ^= q - 1;
+            for (auto &axis : axes)
+                axis ^= t;
+
+            return EncodeMorton(axes[0], axes[1], axes[2]);
+        }
+    } // namespace details
+
+    // Hilbert index of 'point' inside 'box' on the same 2^21 grid per axis as EncodeMorton.
+    inline uint64_t EncodeHilbert(const glm::vec3 &point, const AABB &box) {
+        glm::vec3 extent = GetExtent(box);
+        float max_extent = glm::max(glm::max(extent.x, extent.y), extent.z);
+        float scale = (max_extent > 0.0f) ? static_cast<float>(MORTON_AXIS_MAX) / max_extent : 0.0f;
+
+        return details::EncodeHilbert(details::Quantize(point.x, box.min.x, scale),
+                                      details::Quantize(point.y, box.min.y, scale),
+                                      details::Quantize(point.z, box.min.z, scale));
+    }
+
+    // Sorts triangles by the curve key of their centroids, so triangles close in space are close
+    // in memory too. Keys, the radix sort and the gather all run in parallel.
+    inline Reordering Reorder(const std::vector<glm::vec3> &points, Curve curve = Curve::Hilbert) {
+        size_t tri_count = GetTriangleCount(points);
+        AABB box = GetCentroidBounds(points);
+
+        std::vector<uint64_t> keys;
+        if (curve == Curve::Morton) {
+            keys = GetMortonCodes(points, box);
+        } else {
+            keys.resize(tri_count);
+            parallel::For(tri_count, parallel::DEFAULT_GRAIN * 16, [&](size_t begin, size_t end, size_t) {
+                for (size_t i = begin; i < end; ++i)
+                    keys[i] = EncodeHilbert(GetCentroid(GetTriangle(points, i)), box);
+            });
+        }
+
+        Reordering reordering;
+        reordering.order.resize(tri_count);
+        std::iota(reordering.order.begin(), reordering.order.end(), 0U);
+        parallel::SortByKey(keys, reordering.order, MORTON_BITS);
+
+        reordering.points.resize(3 * tri_count);
+        parallel::For(tri_count, parallel::DEFAULT_GRAIN * 16, [&](size_t begin, size_t end, size_t) {
+            for (size_t i = begin; i < end; ++i)
+                for (size_t k = 0; k < 3; ++k)
+                    reordering.points[3 * i + k] = points[3 * reordering.order[i] + k];
+        });
+
+        return reordering;
+    }
+
+    // Maps a result computed on reordered triangles back to the input indices.
+    inline Result RestoreOrder(Result &&result, const std::vector<uint32_t> &order) {
+        size_t tri_count = order.size();
+        Result restored{Bitset{tri_count}, {}, {}, std::move(result.stats)};
+
+        for (size_t i = 0; i < tri_count; ++i)
+            if (result.flags[i])
+                restored.flags.Set(order[i]);
+
+        if (result.graph.GetVertexCount() == tri_count) {
+            std::vector<PairBuffer> buffers(1);
+            for (size_t i = 0; i < tri_count; ++i)
+                result.graph.ForEachNeighbor(i, [&](uint32_t j) {
+                    if (i < j)
+                        buffers[0].emplace_back(order[i], order[j]);
+                });
+            restored.graph = BuildPairGraph(tri_count, buffers);
+        }
+
+        // Cluster labels are the smallest member index, so they have to be computed again.
+        if (!result.clusters.empty())
+            restored.clusters = LabelClusters(restored.graph);
+
+        return restored;
+    }
+} // namespace intersection
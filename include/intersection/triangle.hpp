@@ -0,0 +1,72 @@
+#pragma once
+
+#include <glm/glm.hpp>
+
+#include <vector>
+#include <cstdint>
+
+namespace intersection {
+    constexpr float EPSILON = 1e-5f;
+
+    struct Triangle {
+        glm::vec3 a;
+        glm::vec3 b;
+        glm::vec3 c;
+    };
+
+    struct AABB {
+        glm::vec3 min;
+        glm::vec3 max;
+    };
+
+    inline Triangle GetTriangle(const std::vector<glm::vec3> &points, size_t index) {
+        return Triangle{points[3 * index + 0], points[3 * index + 1], points[3 * index + 2]};
+    }
+
+    inline size_t GetTriangleCount(const std::vector<glm::vec3> &points) {
+        return points.size() / 3;
+    }
+
+    inline AABB GetBounds(const Triangle &tri) {
+        return AABB{glm::min(glm::min(tri.a, tri.b), tri.c), glm::max(glm::max(tri.a, tri.b), tri.c)};
+    }
+
+    inline glm::vec3 GetCentroid(const Triangle &tri) {
+        return (tri.a + tri.b + tri.c) * (1.0f / 3.0f);
+    }
+
+    inline glm::vec3 GetCenter(const AABB &box) {
+        return (box.min + box.max) * 0.5f;
+    }
+
+    inline glm::vec3 GetExtent(const AABB &box) {
+        return box.max - box.min;
+    }
+
+    inline AABB Merge(const AABB &lhs, const AABB &rhs) {
+        return AABB{glm::min(lhs.min, rhs.min), glm::max(lhs.max, rhs.max)};
+    }
+
+    inline bool Overlaps(const AABB &lhs, const AABB &rhs) {
+        return lhs.min.x <= rhs.max.x + EPSILON && rhs.min.x <= lhs.max.x + EPSILON &&
+               lhs.min.y <= rhs.max.y + EPSILON && rhs.min.y <= lhs.max.y + EPSILON &&
+               lhs.min.z <= rhs.max.z + EPSILON && rhs.min.z <= lhs.max.z + EPSILON;
+    }
+
+    inline bool Contains(const AABB &outer, const AABB &inner) {
+        return outer.min.x <= inner.min.x && inner.max.x <= outer.max.x &&
+               outer.min.y <= inner.min.y && inner.max.y <= outer.max.y &&
+               outer.min.z <= inner.min.z && inner.max.z <= outer.max.z;
+    }
+
+    inline std::vector<AABB> GetBounds(const std::vector<glm::vec3> &points) {
+        size_t tri_count = GetTriangleCount(points);
+        std::vector<AABB> bounds;
+        bounds.reserve(tri_count);
+
+        for (size_t i = 0; i < tri_count; ++i)
+            bounds.push_back(GetBounds(GetTriangle(points, i)));
+
+        return bounds;
+    }
+} // namespace intersection
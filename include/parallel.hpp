@@ -0,0 +1,183 @@
+#pragma once
+
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <cstdint>
+#include <cstdlib>
+#include <exception>
+#include <iterator>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+namespace parallel {
+    constexpr size_t DEFAULT_GRAIN = 256U;
+
+    // Worker count: TRIANGLES_THREADS if set, otherwise the hardware concurrency.
+    inline size_t GetThreadCount() {
+        static const size_t count = [] {
+            if (const char *env = std::getenv("TRIANGLES_THREADS")) {
+                long value = std::strtol(env, nullptr, 10);
+                if (value > 0)
+                    return static_cast<size_t>(value);
+            }
+            size_t hardware = std::thread::hardware_concurrency();
+            return (hardware == 0) ? size_t{1} : hardware;
+        }();
+        return count;
+    }
+
+    // Runs 'func(begin, end, thread_index)' over [0, count) split into blocks of 'grain' items.
+    // Threads grab blocks dynamically, so uneven work per item is balanced between them.
+    // The first exception thrown by a worker is rethrown on the calling thread.
+    template <typename FuncT>
+    void For(size_t count, size_t grain, FuncT &&func, size_t thread_count = GetThreadCount()) {
+        grain = std::max<size_t>(grain, 1);
+        thread_count = std::min(thread_count, (count + grain - 1) / grain);
+        if (thread_count <= 1) {
+            if (count > 0)
+                func(size_t{0}, count, size_t{0});
+            return;
+        }
+
+        std::atomic<size_t> next{0};
+        std::exception_ptr error;
+        std::mutex error_mutex;
+
+        auto worker = [&](size_t thread_index) {
+            try {
+                for (size_t begin = next.fetch_add(grain); begin < count; begin = next.fetch_add(grain))
+                    func(begin, std::min(begin + grain, count), thread_index);
+            } catch (...) {
+                std::lock_guard<std::mutex> lock{error_mutex};
+                if (!error)
+                    error = std::current_exception();
+                next.store(count);
+            }
+        };
+
+        std::vector<std::thread> threads;
+        threads.reserve(thread_count - 1);
+        for (size_t i = 1; i < thread_count; ++i)
+            threads.emplace_back(worker, i);
+
+        worker(0);
+        for (auto &thread : threads)
+            thread.join();
+
+        if (error)
+            std::rethrow_exception(error);
+    }
+
+    // Lock-free multi-producer queue of item batches with a single consumer. Producers push
+    // with a CAS on the list head; the consumer detaches the whole list at once, so no
+    // node is ever popped alone and the usual ABA problem cannot happen.
+    template <typename T>
+    class BatchQueue final {
+    public:
+        BatchQueue() = default;
+        BatchQueue(const BatchQueue &other) = delete;
+        BatchQueue &operator=(const BatchQueue &other) = delete;
+
+        ~BatchQueue() {
+            PopAll();
+        }
+
+        void Push(std::vector<T> &&batch) {
+            auto *node = new Node{std::move(batch), head_.load(std::memory_order_relaxed)};
+            while (!head_.compare_exchange_weak(node->next, node, std::memory_order_release, std::memory_order_relaxed)) {}
+        }
+
+        // Takes every item pushed so far, oldest batch first.
+        std::vector<T> PopAll() {
+            Node *node = head_.exchange(nullptr, std::memory_order_acquire);
+
+            Node *oldest = nullptr;
+            while (node) {
+                Node *next = node->next;
+                node->next = oldest;
+                oldest = node;
+                node = next;
+            }
+
+            std::vector<T> items;
+            while (oldest) {
+                items.insert(items.end(), std::make_move_iterator(oldest->batch.begin()), std::make_move_iterator(oldest->batch.end()));
+                Node *next = oldest->next;
+                delete oldest;
+                oldest = next;
+            }
+
+            return items;
+        }
+
+    private:
+        struct Node {
+            std::vector<T> batch;
+            Node *next;
+        };
+
+        std::atomic<Node *> head_{nullptr};
+    }; // class BatchQueue
+
+    constexpr size_t RADIX_BITS = 8U;
+    constexpr size_t RADIX_BUCKETS = size_t{1} << RADIX_BITS;
+
+    // Stable LSD radix sort of 'values' by 'keys', only the lowest 'key_bits' bits are compared.
+    // Every pass builds per-block digit histograms and scatters blocks in parallel; blocks are
+    // contiguous and scattered to offsets ordered by block, which keeps every pass stable.
+    template <typename ValueT>
+    void SortByKey(std::vector<uint64_t> &keys, std::vector<ValueT> &values, size_t key_bits = 64) {
+        size_t count = keys.size();
+        if (count == 0)
+            return;
+
+        size_t block_size = (count + GetThreadCount() - 1) / GetThreadCount();
+        block_size = std::max(block_size, DEFAULT_GRAIN);
+        size_t block_count = (count + block_size - 1) / block_size;
+
+        std::vector<uint64_t> keys_tmp(count);
+        std::vector<ValueT> values_tmp(count);
+        std::vector<std::array<size_t, RADIX_BUCKETS>> offsets(block_count);
+
+        for (size_t shift = 0; shift < key_bits; shift += RADIX_BITS) {
+            auto digit = [shift](uint64_t key) { return (key >> shift) & (RADIX_BUCKETS - 1); };
+
+            For(count, block_size, [&](size_t begin, size_t end, size_t) {
+                auto &histogram = offsets[begin / block_size];
+                histogram.fill(0U);
+                for (size_t i = begin; i < end; ++i)
+                    ++histogram[digit(keys[i])];
+            });
+
+            // All keys share this digit, the pass would not move anything.
+            size_t same = 0;
+            for (const auto &histogram : offsets)
+                same += histogram[digit(keys[0])];
+            if (same == count)
+                continue;
+
+            size_t total = 0;
+            for (size_t bucket = 0; bucket < RADIX_BUCKETS; ++bucket) {
+                for (auto &histogram : offsets) {
+                    size_t bucket_count = histogram[bucket];
+                    histogram[bucket] = total;
+                    total += bucket_count;
+                }
+            }
+
+            For(count, block_size, [&](size_t begin, size_t end, size_t) {
+                auto &offset = offsets[begin / block_size];
+                for (size_t i = begin; i < end; ++i) {
+                    size_t pos = offset[digit(keys[i])]++;
+                    keys_tmp[pos] = keys[i];
+                    values_tmp[pos] = std::move(values[i]);
+                }
+            });
+
+            keys.swap(keys_tmp);
+            values.swap(values_tmp);
+        }
+    }
+} // namespace parallel
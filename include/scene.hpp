@@ -1,9 +1,12 @@
 #pragma once
 
-#include "geometry.hpp"
-#include "octotree.hpp"
-#include "real_nums.hpp"
+#include "intersection/intersector.hpp"
+#include "intersection/cache.hpp"
+#include "intersection/planner.hpp"
+#include "intersection/reorder.hpp"
 #include "GL/gl.hpp"
+#include "GL/mesh.hpp"
+#include "parallel.hpp"
 #include <cassert>
 
 #include <iostream>
@@ -35,16 +38,10 @@ namespace scene {
 
         glm::vec3 GetCenter() {
             if (glm::all(glm::epsilonEqual(center_, glm::vec3(0.0f), 0.01f))) {
-                glm::vec3 min_point = points_.front();
-                glm::vec3 max_point = points_.front();
-
-                for (const auto &point : points_) {
-                    min_point = glm::min(min_point, point);
-                    max_point = glm::max(max_point, point);
-                }
-                max_point_ = max_point;
-                min_point_ = min_point;
-                center_ = glm::vec3(min_point + max_point) * 0.5f;
+                auto box = intersection::GetPointBounds(points_);
+                max_point_ = box.max;
+                min_point_ = box.min;
+                center_ = glm::vec3(box.min + box.max) * 0.5f;
             }
             
             return center_;
@@ -64,6 +61,26 @@ namespace scene {
             return points_;
         }
 
+        // Sorts the triangles along 'curve' for memory locality in the intersection and the draw.
+        void Reorder(intersection::Curve curve) {
+            auto &&reordering = intersection::Reorder(points_, curve);
+            points_ = std::move(reordering.points);
+
+            if (!order_.empty())
+                for (auto &index : reordering.order)
+                    index = order_[index];
+            order_ = std::move(reordering.order);
+        }
+
+        // Input index of triangle 'index', differs from it once the scene is reordered.
+        size_t GetInputIndex(size_t index) const {
+            return order_.empty() ? index : order_[index];
+        }
+
+        const std::vector<uint32_t> &GetOrder() const {
+            return order_;
+        }
+
         float GetMax() const {
             return glm::max(glm::max(max_point_.x, max_point_.y), max_point_.z);
         }
@@ -117,14 +134,66 @@ namespace scene {
         glm::vec3 min_point_ = glm::vec3(0.0f);
         size_t point_count_ = 0;
         std::vector<glm::vec3> points_;
+        std::vector<uint32_t> order_;
     }; // class TriangleScene
 
+    inline const glm::vec3 INTERSECTED_COLOR{1.0f, 0.0f, 0.0f};
+    inline const glm::vec3 SEPARATE_COLOR{0.0f, 0.0f, 1.0f};
+    inline const glm::vec3 PENDING_COLOR{0.5f, 0.5f, 0.5f};
+
+    constexpr size_t CHUNK_TRIANGLES = 1024U;
+
     class GeometryData final {
     public:
-        GeometryData(const TriangleScene &scene) {
+        // Geometry without an intersection result yet, every triangle is drawn in the pending color.
+        explicit GeometryData(const TriangleScene &scene) : order_(scene.GetOrder()) {
             CreateData(scene.GetPoints());
         }
 
+        GeometryData(const TriangleScene &scene, const intersection::Options &options,
+                     const intersection::ResultCache *cache = nullptr) : order_(scene.GetOrder()) {
+            const auto &points = scene.GetPoints();
+            CreateData(points);
+            SetResult(cache ? intersection::Intersect(points, options, *cache)
+                            : intersection::Intersect(points, options));
+        }
+
+        // 'result' is computed on the scene points. Colors follow them, the flags, the graph and the
+        // clusters are mapped back to the input indices of a reordered scene.
+        void SetResult(intersection::Result &&result) {
+            SetColors(result.flags);
+            if (!order_.empty())
+                result = intersection::RestoreOrder(std::move(result), order_);
+
+            flags_ = std::move(result.flags);
+            graph_ = std::move(result.graph);
+            clusters_ = std::move(result.clusters);
+            stats_ = std::move(result.stats);
+        }
+
+        // Intersected triangles by input index.
+        const intersection::Bitset &GetFlags() const {
+            return flags_;
+        }
+
+        // Pairs by input index.
+        const intersection::PairGraph &GetIntersectionGraph() const {
+            return graph_;
+        }
+
+        // Cluster labels by input index.
+        const std::vector<uint32_t> &GetClusters() const {
+            return clusters_;
+        }
+
+        const intersection::Stats &GetStats() const {
+            return stats_;
+        }
+
+        const std::vector<glm::vec3> &GetColors() const {
+            return colors_;
+        }
+
         std::vector<gl::Vertex> GetData() const {
             std::vector<gl::Vertex> vertices;
             size_t fig_count = colors_.size();
@@ -137,66 +206,55 @@ namespace scene {
             return vertices;
         }
 
+        // Consecutive runs of 'chunk_triangles' triangles with their bounds. They are spatially
+        // coherent only once the scene is sorted along a curve, see TriangleScene::Reorder; in input
+        // order every chunk may span the whole scene and culling them gains nothing.
+        std::vector<gl::Chunk> GetChunks(size_t chunk_triangles = CHUNK_TRIANGLES) const {
+            size_t fig_count = colors_.size();
+            std::vector<gl::Chunk> chunks((fig_count + chunk_triangles - 1) / chunk_triangles);
+
+            parallel::For(chunks.size(), 1, [&](size_t begin, size_t end, size_t) {
+                for (size_t c = begin; c < end; ++c) {
+                    auto &chunk = chunks[c];
+                    chunk.first = c * chunk_triangles;
+                    chunk.count = std::min(chunk_triangles, fig_count - chunk.first);
+                    chunk.min = chunk.max = coords_[3 * chunk.first];
+                    for (size_t i = 3 * chunk.first; i < 3 * (chunk.first + chunk.count); ++i) {
+                        chunk.min = glm::min(chunk.min, coords_[i]);
+                        chunk.max = glm::max(chunk.max, coords_[i]);
+                    }
+                }
+            });
+
+            return chunks;
+        }
+
     private:
         void CreateData(const std::vector<glm::vec3> &points) {
-            size_t points_count = points.size();
-            
-            coords_.reserve(points_count);
-            colors_.reserve(points_count / 3);
-            normals_.reserve(points_count / 3);
+            size_t figs_count = points.size() / 3;
             
-            std::set<size_t> intersected_figs;
-            auto &&figs = CreateFigsAndSetCoords(points);
-            octotree::intersect_figs<float>(figs, intersected_figs);
-            SetColorsAndNormals(points, intersected_figs);
-        }
-
-        std::vector<geometry::figure_t<float>> CreateFigsAndSetCoords(const std::vector<glm::vec3> &points) {
-            std::vector<geometry::figure_t<float>> figs;
-            size_t points_count = points.size();
-            figs.reserve(points_count / 3);
-
-            for (size_t i = 0; i < points_count; i += 3) {
-                coords_.push_back(points[i + 0]); 
-                coords_.push_back(points[i + 1]);
-                coords_.push_back(points[i + 2]);
-                
-                geometry::point_t<float> point1{points[i + 0].x, points[i + 0].y, points[i + 0].z};
-                geometry::point_t<float> point2{points[i + 1].x, points[i + 1].y, points[i + 1].z};
-                geometry::point_t<float> point3{points[i + 2].x, points[i + 2].y, points[i + 2].z};
-        
-                geometry::figure_t<float> fig = geometry::figure_ctor<float>(point1, point2, point3);
-                figs.push_back(fig);
-            }
+            coords_.assign(points.begin(), points.end());
+            colors_.assign(figs_count, PENDING_COLOR);
+            normals_ = intersection::GetNormals(points);
 
-            return figs;
+            assert(normals_.size() == colors_.size());
+            assert(coords_.size() == 3 * colors_.size());
         }
 
-        void SetColorsAndNormals(const std::vector<glm::vec3> points, const std::set<size_t> &intersected_figs) {
-            auto it = intersected_figs.begin();
-            auto end = intersected_figs.end();
-            size_t figs_count = coords_.size() / 3;
-
-            for (size_t i = 0; i < figs_count; ++i) {
-                if (it != end && *it == i) {
-                    ++it;
-                    colors_.emplace_back(1.0f, 0.0f, 0.0f);
-                } else {
-                    colors_.emplace_back(0.0f, 0.0f, 1.0f);
-                }
-
-                auto AB = points[3 * i + 1] - points[3 * i + 0];
-                auto AC = points[3 * i + 2] - points[3 * i + 0];
-
-                normals_.push_back(glm::normalize(glm::cross(AB, AC)));
-            }
+        void SetColors(const intersection::Bitset &intersected_figs) {
+            size_t figs_count = colors_.size();
 
-            assert(normals_.size() == colors_.size());
-            assert(coords_.size() == 3 * colors_.size());
+            for (size_t i = 0; i < figs_count; ++i)
+                colors_[i] = intersected_figs[i] ? INTERSECTED_COLOR : SEPARATE_COLOR;
         }
 
         std::vector<glm::vec3> coords_;
         std::vector<glm::vec3> colors_;
         std::vector<glm::vec3> normals_;
+        std::vector<uint32_t> order_;
+        intersection::Bitset flags_;
+        intersection::PairGraph graph_;
+        std::vector<uint32_t> clusters_;
+        intersection::Stats stats_;
     };
 }
\ No newline at end of file
@@ -0,0 +1,55 @@
+#version 430 core
+layout (local_size_x = 64) in;
+
+struct Chunk {
+    vec4 boxMin;
+    vec4 boxMax;
+    uint first;
+    uint count;
+    uint pad0;
+    uint pad1;
+};
+
+struct DrawCommand {
+    uint count;
+    uint instanceCount;
+    uint first;
+    uint baseInstance;
+};
+
+layout (std430, binding = 0) readonly buffer Chunks {
+    Chunk chunks[];
+};
+
+layout (std430, binding = 1) writeonly buffer Commands {
+    DrawCommand commands[];
+};
+
+layout (std430, binding = 2) buffer Parameters {
+    uint drawCount;
+    uint drawnTriangles;
+};
+
+layout (location = 0) uniform vec4 planes[6];
+layout (location = 6) uniform uint chunkCount;
+
+// Every chunk keeps its own command slot so the draw order does not depend on the order the
+// invocations run in; culled chunks get zero instances and the draw count ends at the last visible one.
+void main() {
+    uint index = gl_GlobalInvocationID.x;
+    if (index >= chunkCount)
+        return;
+
+    Chunk chunk = chunks[index];
+    bool inside = true;
+    for (int p = 0; p < 6; ++p) {
+        vec3 corner = mix(chunk.boxMin.xyz, chunk.boxMax.xyz, greaterThanEqual(planes[p].xyz, vec3(0.0)));
+        inside = inside && (dot(planes[p].xyz, corner) + planes[p].w >= 0.0);
+    }
+
+    commands[index] = DrawCommand(3u * chunk.count, inside ? 1u : 0u, 3u * chunk.first, 0u);
+    if (inside) {
+        atomicMax(drawCount, index + 1u);
+        atomicAdd(drawnTriangles, chunk.count);
+    }
+}
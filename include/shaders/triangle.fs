@@ -6,18 +6,22 @@ in vec3 fragPos;
 
 out vec4 finalColor;
 
-uniform vec3 lightPos;
-uniform vec3 lightColor;
+layout (std140) uniform FrameUniforms {
+    mat4 projection;
+    mat4 view;
+    vec4 lightPos;
+    vec4 lightColor;
+};
 
 void main()
 {
     float ambientStrength = 0.2f;
-    vec3 ambient = ambientStrength * lightColor;
+    vec3 ambient = ambientStrength * lightColor.xyz;
 
     vec3 norm = normalize(fragNormal);
-    vec3 lightDir = normalize(lightPos - fragPos);
+    vec3 lightDir = normalize(lightPos.xyz - fragPos);
     float diff = dot(norm, lightDir);
-    vec3 diffuse = diff * lightColor;
+    vec3 diffuse = diff * lightColor.xyz;
 
     vec3 result;
     if (gl_FrontFacing) {
@@ -7,8 +7,12 @@ out vec3 fragColor;
 out vec3 fragNormal;
 out vec3 fragPos;
 
-uniform mat4 view;
-uniform mat4 projection;
+layout (std140) uniform FrameUniforms {
+    mat4 projection;
+    mat4 view;
+    vec4 lightPos;
+    vec4 lightColor;
+};
 
 void main() 
 {
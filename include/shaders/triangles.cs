@@ -0,0 +1,132 @@
+#version 430 core
+layout (local_size_x = 64) in;
+
+struct Chunk {
+    vec4 boxMin;
+    vec4 boxMax;
+    uint first;
+    uint count;
+    uint pad0;
+    uint pad1;
+};
+
+struct DrawCommand {
+    uint count;
+    uint instanceCount;
+    uint first;
+    uint baseInstance;
+};
+
+struct DrawElementsCommand {
+    uint count;
+    uint instanceCount;
+    uint firstIndex;
+    int baseVertex;
+    uint baseInstance;
+};
+
+layout (std430, binding = 0) readonly buffer Chunks {
+    Chunk chunks[];
+};
+
+layout (std430, binding = 1) readonly buffer Commands {
+    DrawCommand commands[];
+};
+
+layout (std430, binding = 2) buffer Parameters {
+    uint drawCount;
+    uint drawnTriangles;
+    uint smallTriangles;
+};
+
+// The mesh vertex buffer: position, color and normal of every vertex.
+layout (std430, binding = 3) readonly buffer Vertices {
+    float vertices[];
+};
+
+layout (std430, binding = 4) writeonly buffer Indices {
+    uint indices[];
+};
+
+layout (std430, binding = 5) writeonly buffer ElementCommands {
+    DrawElementsCommand elementCommands[];
+};
+
+layout (location = 0) uniform mat4 viewProjection;
+layout (location = 1) uniform vec2 viewport;
+layout (location = 2) uniform uint chunkCount;
+
+// Widens the bounds against the rounding differences between this pass and the vertex shader.
+const float SAMPLE_MARGIN = 1.0 / 64.0;
+
+shared uint kept[64];
+
+vec4 Project(uint vertex) {
+    uint base = 9u * vertex;
+    return viewProjection * vec4(vertices[base], vertices[base + 1u], vertices[base + 2u], 1.0);
+}
+
+// A triangle whose screen bounds hold no pixel center in x or in y covers no sample. Triangles
+// reaching behind the eye are kept, their bounds are not those of the projected corners, and so
+// is everything while the viewport is unknown.
+bool IsBetweenSamples(uint triangle) {
+    if (viewport.x <= 0.0)
+        return false;
+
+    vec4 a = Project(3u * triangle);
+    vec4 b = Project(3u * triangle + 1u);
+    vec4 c = Project(3u * triangle + 2u);
+    if (a.w <= 0.0 || b.w <= 0.0 || c.w <= 0.0)
+        return false;
+
+    vec2 sa = (a.xy / a.w * 0.5 + 0.5) * viewport;
+    vec2 sb = (b.xy / b.w * 0.5 + 0.5) * viewport;
+    vec2 sc = (c.xy / c.w * 0.5 + 0.5) * viewport;
+    vec2 low = min(sa, min(sb, sc)) - 0.5 - SAMPLE_MARGIN;
+    vec2 high = max(sa, max(sb, sc)) - 0.5 + SAMPLE_MARGIN;
+    return any(greaterThan(ceil(low), floor(high)));
+}
+
+// One work group per chunk. The triangles a chunk keeps are compacted into its own range of the
+// index buffer in their original order, through a prefix sum over each batch of 64.
+void main() {
+    uint index = gl_WorkGroupID.y * gl_NumWorkGroups.x + gl_WorkGroupID.x;
+    if (index >= chunkCount)
+        return;
+
+    Chunk chunk = chunks[index];
+    uint instances = commands[index].instanceCount;
+    uint local = gl_LocalInvocationID.x;
+    uint written = 0u;
+
+    if (instances != 0u) {
+        for (uint base = 0u; base < chunk.count; base += 64u) {
+            uint triangle = chunk.first + base + local;
+            bool keep = base + local < chunk.count && !IsBetweenSamples(triangle);
+            kept[local] = keep ? 1u : 0u;
+            barrier();
+
+            for (uint offset = 1u; offset < 64u; offset <<= 1u) {
+                uint sum = local >= offset ? kept[local - offset] : 0u;
+                barrier();
+                kept[local] += sum;
+                barrier();
+            }
+
+            if (keep) {
+                uint slot = 3u * (chunk.first + written + kept[local] - 1u);
+                indices[slot] = 3u * triangle;
+                indices[slot + 1u] = 3u * triangle + 1u;
+                indices[slot + 2u] = 3u * triangle + 2u;
+            }
+            written += kept[63];
+            barrier();
+        }
+
+        if (local == 0u)
+            atomicAdd(smallTriangles, chunk.count - written);
+    }
+
+    if (local == 0u)
+        elementCommands[index] = DrawElementsCommand(3u * written, instances, 3u * chunk.first, 0, 0u);
+}
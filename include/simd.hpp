@@ -0,0 +1,66 @@
+#pragma once
+
+#include <algorithm>
+#include <cstdlib>
+#include <stdexcept>
+#include <string>
+#include <string_view>
+
+// Kernels for wider instruction sets are compiled with per-function target attributes, so the
+// build keeps its generic baseline and the best variant is picked at run time.
+#if (defined(__GNUC__) || defined(__clang__)) && (defined(__x86_64__) || defined(__i386__))
+    #define TRIANGLES_X86_KERNELS 1
+    #define TRIANGLES_TARGET(isa) __attribute__((target(isa)))
+#else
+    #define TRIANGLES_X86_KERNELS 0
+#endif
+
+namespace simd {
+    enum class Isa {
+        Scalar,
+        SSE42,
+        AVX2,
+        AVX512
+    };
+
+    inline std::string_view GetIsaName(Isa isa) {
+        switch (isa) {
+            case Isa::SSE42:  return "sse4.2";
+            case Isa::AVX2:   return "avx2";
+            case Isa::AVX512: return "avx512";
+            default:          return "scalar";
+        }
+    }
+
+    inline Isa ParseIsa(std::string_view name) {
+        for (Isa isa : {Isa::Scalar, Isa::SSE42, Isa::AVX2, Isa::AVX512})
+            if (name == GetIsaName(isa))
+                return isa;
+        throw std::invalid_argument("Unknown instruction set '" + std::string{name} + "'");
+    }
+
+    // Widest instruction set the CPU supports.
+    inline Isa DetectIsa() {
+#if TRIANGLES_X86_KERNELS
+        __builtin_cpu_init();
+        if (__builtin_cpu_supports("avx512f"))
+            return Isa::AVX512;
+        if (__builtin_cpu_supports("avx2"))
+            return Isa::AVX2;
+        if (__builtin_cpu_supports("sse4.2"))
+            return Isa::SSE42;
+#endif
+        return Isa::Scalar;
+    }
+
+    // Instruction set used by the kernels: the detected one, capped by TRIANGLES_ISA if set.
+    inline Isa GetIsa() {
+        static const Isa isa = [] {
+            Isa detected = DetectIsa();
+            if (const char *env = std::getenv("TRIANGLES_ISA"))
+                return std::min(detected, ParseIsa(env));
+            return detected;
+        }();
+        return isa;
+    }
+} // namespace simd
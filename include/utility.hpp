@@ -1,6 +1,9 @@
 #pragma once
 
+#include <cstdlib>
 #include <filesystem>
+#include <fstream>
+#include <iterator>
 #include <vector>
 #include <string>
 #include <format>
@@ -34,4 +37,32 @@ namespace file {
 
         return files;
     }
+
+    // The file 'name' + 'extension' of the 'dir' folder, for folders holding several of a kind.
+    inline std::string FindFile(std::string_view dir, std::string_view name, std::string_view extension) {
+        for (auto &&file : FindFile(dir, extension))
+            if (fs::path(file).stem() == name)
+                return file;
+
+        throw std::runtime_error(std::format("'{}{}' was not found in the '{}' folder.\n", name, extension, dir));
+    }
+
+    inline std::string ReadFile(std::string_view file_name) {
+        std::ifstream stream(file_name.data());
+        if (!stream.is_open())
+            throw std::runtime_error(std::format("File '{}' is not found", file_name));
+
+        return std::string(std::istreambuf_iterator<char>(stream), std::istreambuf_iterator<char>());
+    }
+
+    // Per-user folder for the caches: TRIANGLES_CACHE_DIR, else the XDG cache folder, else ~/.cache.
+    inline fs::path GetCacheDir() {
+        if (const char *dir = std::getenv("TRIANGLES_CACHE_DIR"))
+            return dir;
+        if (const char *dir = std::getenv("XDG_CACHE_HOME"))
+            return fs::path{dir} / "triangles-opengl";
+        if (const char *dir = std::getenv("HOME"))
+            return fs::path{dir} / ".cache" / "triangles-opengl";
+        return fs::temp_directory_path() / "triangles-opengl";
+    }
 } // namespace file
\ No newline at end of file
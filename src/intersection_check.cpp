@@ -0,0 +1,340 @@
+#include "intersection/duplicates.hpp"
+#include "intersection/incremental.hpp"
+#include "intersection/intersector.hpp"
+#include "intersection/out_of_core.hpp"
+#include "intersection/planner.hpp"
+#include "intersection/reorder.hpp"
+
+#include <algorithm>
+#include <cstdint>
+#include <format>
+#include <fstream>
+#include <iostream>
+#include <numeric>
+#include <stdexcept>
+#include <string>
+#include <utility>
+#include <vector>
+
+// Checks the intersection engine in its main configurations against a brute-force test of every
+// pair of the scene. Usage: intersection_check <scene file in the TriangleScene text format>
+// With --mesh, checks mesh_adjacency on welded meshes with known self-intersections instead.
+
+namespace {
+    constexpr size_t OUT_OF_CORE_CHECK_TRIANGLES = 16U;
+    constexpr size_t MOVE_STRIDE = 7U;  // every MOVE_STRIDE-th triangle moves in an incremental update
+    constexpr size_t MOVE_ROUNDS = 2U;
+    constexpr float CHECK_DUPLICATE_TOLERANCE = 0.05f;
+
+    using Pairs = std::vector<std::pair<uint32_t, uint32_t>>;
+
+    std::vector<glm::vec3> ReadPoints(std::istream &input) {
+        size_t fig_count = 0;
+        input >> fig_count;
+        if (!input.good())
+            throw std::runtime_error("Input is failed when reading figure count");
+
+        std::vector<glm::vec3> points(3 * fig_count);
+        for (auto &point : points) {
+            input >> point.x >> point.y >> point.z;
+            if (input.fail())
+                throw std::runtime_error("Input is failed when reading coordinates");
+        }
+
+        return points;
+    }
+
+    Pairs GetPairs(const intersection::PairGraph &graph) {
+        Pairs pairs;
+        for (size_t i = 0; i < graph.GetVertexCount(); ++i)
+            graph.ForEachNeighbor(i, [&](uint32_t j) {
+                if (i < j)
+                    pairs.emplace_back(static_cast<uint32_t>(i), j);
+            });
+
+        std::sort(pairs.begin(), pairs.end());
+        return pairs;
+    }
+
+    // Every pair through the narrow phase, with the kinds and normals the engine uses. Exact copies
+    // touch by definition, the narrow phase can miss that for slivers.
+    Pairs GetReferencePairs(const std::vector<glm::vec3> &points) {
+        using namespace intersection;
+
+        size_t tri_count = GetTriangleCount(points);
+        auto kinds = ClassifyFigures(points).kinds;
+        auto normals = GetNormals(points);
+
+        std::vector<Pairs> found(parallel::GetThreadCount());
+        parallel::For(tri_count, 16, [&](size_t begin, size_t end, size_t thread_index) {
+            for (size_t i = begin; i < end; ++i) {
+                Triangle tri = GetTriangle(points, i);
+                AABB box = GetBounds(tri);
+                for (size_t j = i + 1; j < tri_count; ++j) {
+                    Triangle other = GetTriangle(points, j);
+                    if (!Overlaps(box, GetBounds(other)))
+                        continue;
+
+                    bool hit = (kinds[i] == Kind::Triangle && kinds[j] == Kind::Triangle)
+                                   ? IntersectTriangles(tri, normals[i], other, normals[j])
+                                   : Intersect(tri, kinds[i], other, kinds[j]);
+                    hit = hit || IsExactCopy(points, static_cast<uint32_t>(i), static_cast<uint32_t>(j));
+                    if (hit)
+                        found[thread_index].emplace_back(static_cast<uint32_t>(i), static_cast<uint32_t>(j));
+                }
+            }
+        });
+
+        Pairs pairs;
+        for (const auto &local : found)
+            pairs.insert(pairs.end(), local.begin(), local.end());
+        std::sort(pairs.begin(), pairs.end());
+        return pairs;
+    }
+
+    intersection::Options GetAllPairsOptions() {
+        intersection::Options options;
+        options.mode = intersection::Mode::AllPairs;
+        return options;
+    }
+
+    intersection::Bitset GetFlags(size_t tri_count, const Pairs &pairs) {
+        intersection::Bitset flags{tri_count};
+        for (auto [i, j] : pairs) {
+            flags.Set(i);
+            flags.Set(j);
+        }
+        return flags;
+    }
+
+    // Moves every MOVE_STRIDE-th triangle, starting at 'round', onto the centroid of another one,
+    // so the update both breaks old pairs and makes new ones. Every other moved triangle becomes an
+    // exact copy of its target, with the corners rotated.
+    void MoveTriangles(intersection::IncrementalIntersector &incremental, size_t round) {
+        using namespace intersection;
+
+        const auto &points = incremental.GetPoints();
+        size_t tri_count = GetTriangleCount(points);
+        std::vector<uint32_t> indices;
+        std::vector<glm::vec3> moved;
+        for (size_t i = round; i < tri_count; i += MOVE_STRIDE) {
+            size_t target = (13 * i + 5 * round + 1) % tri_count;
+            glm::vec3 shift = (points[3 * target] + points[3 * target + 1] + points[3 * target + 2] -
+                               points[3 * i] - points[3 * i + 1] - points[3 * i + 2]) / 3.0f;
+
+            indices.push_back(static_cast<uint32_t>(i));
+            bool copy = (indices.size() % 2 == 0 && target != i);
+            for (size_t k = 0; k < 3; ++k)
+                moved.push_back(copy ? points[3 * target + (k + 1) % 3] : points[3 * i + k] + shift);
+        }
+
+        incremental.Update(indices, moved);
+    }
+
+    intersection::Result GetResult(const intersection::IncrementalIntersector &incremental) {
+        size_t tri_count = intersection::GetTriangleCount(incremental.GetPoints());
+        intersection::Result result{incremental.GetFlags(), {}, {}, {}};
+        std::vector<intersection::PairBuffer> buffers(1);
+        for (size_t i = 0; i < tri_count; ++i)
+            for (auto j : incremental.GetPartners(i))
+                if (i < j)
+                    buffers[0].emplace_back(static_cast<uint32_t>(i), j);
+        result.graph = intersection::BuildPairGraph(tri_count, buffers);
+        return result;
+    }
+
+    struct MeshCase {
+        std::string name;
+        std::vector<glm::vec3> points;
+        Pairs expected;
+    };
+
+    // Height field of 'size' x 'size' quads, two triangles each, with every shared corner welded.
+    std::vector<glm::vec3> GetHeightField(size_t size) {
+        auto get_point = [](size_t x, size_t y) {
+            return glm::vec3{static_cast<float>(x), static_cast<float>(y), 0.1f * static_cast<float>(x * x + y)};
+        };
+
+        std::vector<glm::vec3> points;
+        for (size_t y = 0; y < size; ++y)
+            for (size_t x = 0; x < size; ++x) {
+                glm::vec3 a = get_point(x, y), b = get_point(x + 1, y), c = get_point(x, y + 1), d = get_point(x + 1, y + 1);
+                points.insert(points.end(), {a, b, c, b, d, c});
+            }
+        return points;
+    }
+
+    // Every pair of a welded mesh touches along its shared edge or vertex; with mesh_adjacency only
+    // the overlaps beyond that contact may be reported.
+    std::vector<MeshCase> GetMeshCases() {
+        std::vector<MeshCase> cases;
+        cases.push_back({"clean height field", GetHeightField(4), {}});
+
+        // Triangle 2 is folded over the shared edge of 0 and 1, back onto 0.
+        cases.push_back({"fold-over",
+                         {{0, 0, 0}, {1, 0, 0}, {0, 1, 0},
+                          {1, 0, 0}, {1, 1, 0}, {0, 1, 0},
+                          {1, 0, 0}, {0, 1, 0}, {0.25f, 0.25f, 0}},
+                         {{0, 2}}});
+
+        // Triangle 1 shares a corner with 0 and pierces it away from that corner, 2 only touches there.
+        cases.push_back({"crossing at a shared vertex",
+                         {{0, 0, 0}, {1, 0, 0}, {0, 1, 0},
+                          {0, 0, 0}, {0.5f, 0.5f, -1}, {0.5f, 0.5f, 1},
+                          {0, 0, 0}, {-1, 0, 1}, {0, -1, 1}},
+                         {{0, 1}}});
+
+        // The same defects inside a clean mesh: the last triangle is folded over the first quad's
+        // diagonal, the one before pierces the first triangle from its corner.
+        MeshCase mixed{"height field with defects", GetHeightField(3), {}};
+        auto get_corner = [&mixed](size_t tri, size_t k) { return mixed.points[3 * tri + k]; };
+        glm::vec3 apex = get_corner(0, 0), edge = get_corner(0, 1) - apex, side = get_corner(0, 2) - apex;
+        glm::vec3 inside = apex + 0.3f * edge + 0.3f * side, normal = glm::cross(edge, side);
+        uint32_t crossing = static_cast<uint32_t>(intersection::GetTriangleCount(mixed.points));
+        mixed.points.insert(mixed.points.end(), {apex, inside - normal, inside + normal});
+        mixed.points.insert(mixed.points.end(), {get_corner(0, 1), get_corner(0, 2), inside});
+        mixed.expected = {{0, crossing}, {0, crossing + 1}, {crossing, crossing + 1}};
+        cases.push_back(std::move(mixed));
+        return cases;
+    }
+
+    class Checker final {
+    public:
+        Checker(const intersection::Bitset &flags, const Pairs &pairs) : flags_(flags), pairs_(pairs) {}
+
+        void CheckFlags(const std::string &name, const intersection::Bitset &flags) {
+            size_t wrong = flags_.GetSize();
+            if (flags.GetSize() == flags_.GetSize()) {
+                wrong = 0;
+                for (size_t i = 0; i < flags_.GetSize(); ++i)
+                    wrong += (flags[i] != flags_[i]);
+            }
+            Report(name, wrong, "flags");
+        }
+
+        void CheckPairs(const std::string &name, const intersection::Result &result) {
+            CheckFlags(name, result.flags);
+
+            auto pairs = GetPairs(result.graph);
+            Pairs diff;
+            std::set_symmetric_difference(pairs.begin(), pairs.end(), pairs_.begin(), pairs_.end(), std::back_inserter(diff));
+            Report(name, diff.size(), "pairs");
+        }
+
+        void Fail() {
+            ++failures_;
+        }
+
+        bool IsPassed() const {
+            return failures_ == 0;
+        }
+
+    private:
+        void Report(const std::string &name, size_t wrong, const char *what) {
+            if (wrong == 0)
+                return;
+            std::cout << std::format("{}: {} {} differ from the reference\n", name, wrong, what);
+            ++failures_;
+        }
+
+        const intersection::Bitset &flags_;
+        const Pairs &pairs_;
+        size_t failures_ = 0;
+    }; // class Checker
+
+    bool CheckMeshes() {
+        using namespace intersection;
+
+        Options options = GetAllPairsOptions();
+        options.mesh_adjacency = true;
+        Options flags_only = options;
+        flags_only.mode = Mode::FlagsOnly;
+
+        bool passed = true;
+        for (auto &[name, points, expected] : GetMeshCases()) {
+            std::sort(expected.begin(), expected.end());
+            auto flags = GetFlags(GetTriangleCount(points), expected);
+            Checker checker{flags, expected};
+
+            checker.CheckPairs(name, Intersect(points, options));
+            checker.CheckFlags(std::format("{}, flags only", name), Intersect(points, flags_only).flags);
+
+            // Re-testing every triangle in place must find the same pairs.
+            IncrementalIntersector incremental{points, options};
+            std::vector<uint32_t> indices(GetTriangleCount(points));
+            std::iota(indices.begin(), indices.end(), 0U);
+            incremental.Update(indices, points);
+            checker.CheckPairs(std::format("{}, incremental", name), GetResult(incremental));
+
+            std::cout << std::format("{}: {} expected pairs: {}\n", name, expected.size(), checker.IsPassed() ? "passed" : "FAILED");
+            passed = passed && checker.IsPassed();
+        }
+        return passed;
+    }
+} // namespace
+
+int main(int argc, char **argv) try {
+    using namespace intersection;
+
+    if (argc != 2)
+        throw std::invalid_argument("Usage: intersection_check <scene file> | --mesh");
+    if (std::string{argv[1]} == "--mesh")
+        return CheckMeshes() ? 0 : 1;
+
+    std::ifstream input{argv[1]};
+    if (!input.is_open())
+        throw std::runtime_error(std::format("Cannot open '{}'", argv[1]));
+    auto points = ReadPoints(input);
+    size_t tri_count = GetTriangleCount(points);
+
+    auto reference = GetReferencePairs(points);
+    auto reference_flags = GetFlags(tri_count, reference);
+    Checker checker{reference_flags, reference};
+
+    checker.CheckFlags("flags only", Intersect(points).flags);
+    checker.CheckPairs("all pairs", Intersect(points, GetAllPairsOptions()));
+
+    Options linear = GetAllPairsOptions();
+    linear.broad_phase = BroadPhase::LinearOctree;
+    checker.CheckPairs("linear octree", Intersect(points, linear));
+
+    // Near copies within the tolerance are counted, never assumed to touch.
+    Options tolerance = GetAllPairsOptions();
+    tolerance.duplicate_tolerance = CHECK_DUPLICATE_TOLERANCE;
+    checker.CheckPairs("duplicate tolerance", Intersect(points, tolerance));
+    tolerance.mode = Mode::FlagsOnly;
+    checker.CheckFlags("duplicate tolerance, flags only", Intersect(points, tolerance).flags);
+
+    checker.CheckFlags("planned", Intersect(points, MakePlan(points).options).flags);
+
+    auto reordering = Reorder(points, Curve::Hilbert);
+    checker.CheckPairs("reordered", RestoreOrder(Intersect(reordering.points, GetAllPairsOptions()), reordering.order));
+
+    IncrementalIntersector incremental{points};
+    for (size_t round = 0; round < MOVE_ROUNDS; ++round) {
+        MoveTriangles(incremental, round);
+
+        const auto &moved = incremental.GetPoints();
+        auto moved_reference = GetReferencePairs(moved);
+        auto moved_flags = GetFlags(tri_count, moved_reference);
+        Checker moved_checker{moved_flags, moved_reference};
+
+        moved_checker.CheckPairs(std::format("incremental, round {}", round + 1), GetResult(incremental));
+
+        if (!moved_checker.IsPassed())
+            checker.Fail();
+    }
+
+    // A budget of a few triangles splits even the small scenes into tiles.
+    OutOfCoreOptions out_of_core;
+    out_of_core.memory_budget = OUT_OF_CORE_CHECK_TRIANGLES * OUT_OF_CORE_TRIANGLE_FOOTPRINT;
+    std::ifstream stream{argv[1]};
+    checker.CheckFlags("out of core", OutOfCoreIntersector{out_of_core}.Run(stream));
+
+    std::cout << std::format("{} triangles, {} intersecting pairs: {}\n", tri_count, reference.size(),
+                             checker.IsPassed() ? "passed" : "FAILED");
+    return checker.IsPassed() ? 0 : 1;
+} catch (std::exception &ex) {
+    std::cout << "Exceptions is catched: " << ex.what() << std::endl;
+    return 1;
+}
@@ -0,0 +1,136 @@
+#include "intersection/kernels.hpp"
+
+#include <algorithm>
+#include <chrono>
+#include <cstdlib>
+#include <cstring>
+#include <format>
+#include <iostream>
+#include <random>
+#include <string>
+#include <vector>
+
+// Times every geometry kernel at each instruction set level the CPU supports and checks the
+// results against the scalar reference. Usage: kernel_bench [triangle count]
+
+namespace {
+    constexpr size_t DEFAULT_TRIANGLES = 1U << 20;
+    constexpr size_t REPEATS = 5U;
+    constexpr size_t CANDIDATES_PER_QUERY = 64U;
+    constexpr uint32_t SEED = 0xBE4C4U;
+
+    // Best wall time of REPEATS runs, in milliseconds.
+    template <typename FuncT>
+    double Measure(FuncT &&func) {
+        double best = 0.0;
+        for (size_t r = 0; r < REPEATS; ++r) {
+            auto start = std::chrono::steady_clock::now();
+            func();
+            std::chrono::duration<double, std::milli> elapsed = std::chrono::steady_clock::now() - start;
+            best = (r == 0) ? elapsed.count() : std::min(best, elapsed.count());
+        }
+        return best;
+    }
+
+    std::vector<glm::vec3> GeneratePoints(size_t tri_count) {
+        std::mt19937 gen{SEED};
+        std::uniform_real_distribution<float> center{-100.0f, 100.0f};
+        std::uniform_real_distribution<float> offset{-1.0f, 1.0f};
+
+        std::vector<glm::vec3> points;
+        points.reserve(3 * tri_count);
+        for (size_t i = 0; i < tri_count; ++i) {
+            glm::vec3 c{center(gen), center(gen), center(gen)};
+            for (size_t v = 0; v < 3; ++v)
+                points.push_back(c + glm::vec3{offset(gen), offset(gen), offset(gen)});
+        }
+
+        return points;
+    }
+
+    struct Row {
+        std::string kernel;
+        simd::Isa isa;
+        double time;
+        double speedup;
+        bool matches;
+    };
+} // namespace
+
+int main(int argc, char **argv) try {
+    size_t tri_count = (argc > 1) ? std::strtoull(argv[1], nullptr, 10) : DEFAULT_TRIANGLES;
+    if (tri_count == 0)
+        throw std::invalid_argument("Triangle count must be positive");
+
+    auto points = GeneratePoints(tri_count);
+    size_t query_count = std::max<size_t>(tri_count / CANDIDATES_PER_QUERY, 1);
+
+    std::mt19937 gen{SEED};
+    std::uniform_int_distribution<uint32_t> pick{0, static_cast<uint32_t>(tri_count - 1)};
+    std::vector<uint32_t> candidates(query_count * CANDIDATES_PER_QUERY);
+    for (auto &candidate : candidates)
+        candidate = pick(gen);
+
+    simd::Isa detected = simd::DetectIsa();
+    std::cout << std::format("{} triangles, detected instruction set: {}\n", tri_count, simd::GetIsaName(detected));
+
+    auto reference = intersection::kernels::GetKernels(simd::Isa::Scalar);
+    auto ref_box = reference.get_point_bounds(points.data(), points.size());
+    std::vector<glm::vec3> ref_normals(tri_count);
+    reference.get_normals(points.data(), tri_count, ref_normals.data());
+
+    auto filter_all = [&](const intersection::kernels::KernelTable &table, std::vector<uint32_t> &survivors) {
+        size_t kept = 0;
+        for (size_t q = 0; q < query_count; ++q)
+            kept += table.filter_plane_side(intersection::GetTriangle(points, q), points.data(),
+                                            candidates.data() + q * CANDIDATES_PER_QUERY, CANDIDATES_PER_QUERY,
+                                            survivors.data() + kept);
+        survivors.resize(kept);
+    };
+    std::vector<uint32_t> ref_survivors(candidates.size());
+    filter_all(reference, ref_survivors);
+
+    std::vector<Row> rows;
+    double base_time[3] = {};
+    for (simd::Isa isa : {simd::Isa::Scalar, simd::Isa::SSE42, simd::Isa::AVX2, simd::Isa::AVX512}) {
+        if (isa > detected)
+            break;
+
+        auto table = intersection::kernels::GetKernels(isa);
+
+        intersection::AABB box;
+        double time = Measure([&] { box = table.get_point_bounds(points.data(), points.size()); });
+        bool matches = (box.min == ref_box.min && box.max == ref_box.max);
+        rows.push_back({"bounds", isa, time, 0.0, matches});
+
+        std::vector<glm::vec3> normals(tri_count);
+        time = Measure([&] { table.get_normals(points.data(), tri_count, normals.data()); });
+        // Bitwise, so the NaN normals of degenerate triangles compare equal too.
+        matches = (std::memcmp(normals.data(), ref_normals.data(), tri_count * sizeof(glm::vec3)) == 0);
+        rows.push_back({"normals", isa, time, 0.0, matches});
+
+        std::vector<uint32_t> survivors;
+        time = Measure([&] {
+            survivors.assign(candidates.size(), 0U);
+            filter_all(table, survivors);
+        });
+        rows.push_back({"plane filter", isa, time, 0.0, survivors == ref_survivors});
+    }
+
+    for (size_t r = 0; r < rows.size(); ++r) {
+        if (rows[r].isa == simd::Isa::Scalar)
+            base_time[r % 3] = rows[r].time;
+        rows[r].speedup = base_time[r % 3] / rows[r].time;
+    }
+
+    std::cout << "kernel       | isa     | time, ms | speedup | matches scalar\n";
+    for (const auto &row : rows)
+        std::cout << std::format("{:<12} | {:<7} | {:>8.3f} | {:>6.2f}x | {}\n", row.kernel, simd::GetIsaName(row.isa),
+                                 row.time, row.speedup, row.matches ? "yes" : "NO");
+
+    bool all_match = std::all_of(rows.begin(), rows.end(), [](const Row &row) { return row.matches; });
+    return all_match ? 0 : 1;
+} catch (std::exception &ex) {
+    std::cout << "Exceptions is catched: " << ex.what() << std::endl;
+    return 1;
+}
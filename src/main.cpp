@@ -3,43 +3,182 @@
 #include "GL/renderer.hpp"
 #include "GL/mesh.hpp"
 #include "scene.hpp"
+#include "intersection/async.hpp"
+#include "intersection/out_of_core.hpp"
 
 #include <iostream>
 #include <cmath>
+#include <cstdlib>
+#include <optional>
+#include <stdexcept>
+#include <string>
+#include <string_view>
 
 constexpr int START_WIDHT = 800, START_HEIGHT = 600;
 constexpr float FoV = 45.0f;
 
+// TRIANGLES_REORDER selects the space-filling curve the scene is sorted along: hilbert (default), morton or none.
+std::optional<intersection::Curve> GetReorderCurve() {
+    const char *value = std::getenv("TRIANGLES_REORDER");
+    std::string_view name = value ? value : "hilbert";
+
+    if (name == "hilbert")
+        return intersection::Curve::Hilbert;
+    if (name == "morton")
+        return intersection::Curve::Morton;
+    if (name == "none")
+        return std::nullopt;
+    throw std::invalid_argument(std::format("Unknown TRIANGLES_REORDER value '{}'", name));
+}
+
+// TRIANGLES_CULLING selects where the scene chunks are culled: cpu (default), gpu or off.
+std::optional<gl::Culling> GetCulling() {
+    const char *value = std::getenv("TRIANGLES_CULLING");
+    std::string_view name = value ? value : "cpu";
+
+    if (name == "cpu")
+        return gl::Culling::Cpu;
+    if (name == "gpu")
+        return gl::Culling::Gpu;
+    if (name == "off")
+        return std::nullopt;
+    throw std::invalid_argument(std::format("Unknown TRIANGLES_CULLING value '{}'", name));
+}
+
+// TRIANGLES_OUT_OF_CORE=<MiB> intersects a scene too big for memory in tiles of that budget. Nothing
+// is drawn, the indices of the intersecting triangles are printed one per line.
+int RunOutOfCore(std::string_view budget) {
+    intersection::OutOfCoreOptions options;
+    options.memory_budget = std::stoull(std::string{budget}) << 20;
+
+    intersection::OutOfCoreIntersector intersector{options};
+    auto &&flags = intersector.Run(std::cin);
+    for (size_t i = 0; i < flags.GetSize(); ++i)
+        if (flags[i])
+            std::cout << i << '\n';
+
+    if (std::getenv("TRIANGLES_STATS")) {
+        const auto &stats = intersector.GetStats();
+        std::clog << std::format("out of core: {} triangles in {} tiles, {} records, largest tile {}\n", stats.triangle_count,
+                                 stats.tile_count, stats.record_count, stats.max_tile_size);
+    }
+    return 0;
+}
+
 int main() try {
-    std::vector<gl::Vertex> vertices;
+    if (const char *budget = std::getenv("TRIANGLES_OUT_OF_CORE"))
+        return RunOutOfCore(budget);
+
     glm::vec3 cam_pos, cam_target;
     float near = 0.1f, far = 100.0f;
 
-    {
-        scene::TriangleScene tscene{};
-        cam_target = tscene.GetCenter();
-        auto offset = tscene.GetRadius() / glm::tan(glm::radians(FoV * 0.5f));
-        cam_pos = cam_target + glm::vec3(0.0f, 0.0f, offset);
+    scene::TriangleScene tscene{};
+    auto curve = GetReorderCurve();
+    if (curve)
+        tscene.Reorder(*curve);
 
-        auto nearest_dist = tscene.GetNearestDistanceFrom(cam_pos);
-        auto farest_dist = tscene.GetFarestDistanceFrom(cam_pos);
+    cam_target = tscene.GetCenter();
+    auto offset = tscene.GetRadius() / glm::tan(glm::radians(FoV * 0.5f));
+    cam_pos = cam_target + glm::vec3(0.0f, 0.0f, offset);
 
-        near = nearest_dist * 0.1f;
-        far = 1000.0f * near;
-        far = (far > farest_dist) ? far : farest_dist;
+    auto nearest_dist = tscene.GetNearestDistanceFrom(cam_pos);
+    auto farest_dist = tscene.GetFarestDistanceFrom(cam_pos);
 
-        scene::GeometryData geom{tscene};
-        vertices = geom.GetData();
-    }
+    near = nearest_dist * 0.1f;
+    far = 1000.0f * near;
+    far = (far > farest_dist) ? far : farest_dist;
+
+    auto &&plan = intersection::MakePlan(tscene.GetPoints());
+    intersection::PrintPlan(std::clog, plan);
+
+    intersection::Options options = plan.options;
+    options.collect_stats = (std::getenv("TRIANGLES_STATS") != nullptr);
+    options.mesh_adjacency = (std::getenv("TRIANGLES_MESH") != nullptr);
+    if (const char *tolerance = std::getenv("TRIANGLES_DUPLICATE_TOLERANCE"))
+        options.duplicate_tolerance = std::stof(tolerance);
+
+    // The scene is shown right away, triangles turn red as the background run finds them.
+    intersection::ResultCache cache{};
+    intersection::AsyncIntersection run{tscene.GetPoints(), options, &cache};
+    scene::GeometryData geom{tscene};
 
     auto &window = gl::Window::QueryWindow(START_WIDHT, START_HEIGHT, "Triangle scene");
     gl::Camera camera{cam_pos, cam_target, near, far};
     window.SetEventHandler(std::move(std::make_unique<gl::EventHandler>(window, camera)));
     gl::Renderer renderer{};
 
+    auto culling = GetCulling();
+    if (culling && !curve) {
+        std::clog << "Chunks of a scene in input order have no spatial coherence, chunk culling is off\n";
+        culling = std::nullopt;
+    }
+    if (culling == gl::Culling::Gpu && !gl::HasGpuCulling()) {
+        std::clog << "GPU culling needs OpenGL 4.3, chunks are culled on the CPU\n";
+        culling = gl::Culling::Cpu;
+    }
+    auto mesh = culling ? std::make_unique<gl::ProgressiveMesh>(geom.GetData(), geom.GetChunks(), *culling)
+                        : std::make_unique<gl::ProgressiveMesh>(geom.GetData());
+    auto &progressive = *mesh;
+    // TRIANGLES_OCCLUSION adds occlusion culling behind the nearest big chunks to the CPU culling.
+    if (std::getenv("TRIANGLES_OCCLUSION")) {
+        if (culling == gl::Culling::Cpu)
+            progressive.SetOcclusionCulling(true);
+        else
+            std::clog << "Occlusion culling needs TRIANGLES_CULLING=cpu\n";
+    }
+    // TRIANGLES_SMALL_CULLING drops the geometry that falls between the pixel centers.
+    if (std::getenv("TRIANGLES_SMALL_CULLING")) {
+        if (culling)
+            progressive.SetSmallCulling(true);
+        else
+            std::clog << "Small geometry culling needs TRIANGLES_CULLING=cpu or gpu\n";
+    }
+    // TRIANGLES_LOD draws distant chunks from simplified levels built here.
+    if (std::getenv("TRIANGLES_LOD")) {
+        if (culling == gl::Culling::Cpu)
+            progressive.SetLod(true);
+        else
+            std::clog << "Levels of detail need TRIANGLES_CULLING=cpu\n";
+    }
     std::vector<std::unique_ptr<gl::IMesh>> scene;
-    scene.push_back(std::make_unique<gl::TriangleMesh>(vertices));
-    window.DrawFrames(scene.begin(), scene.end(), renderer, camera);
+    scene.push_back(std::move(mesh));
+
+    bool finished = false;
+    gl::CullStats cull_stats;
+    size_t drawn_triangles = 0;
+    window.DrawFrames(scene.begin(), scene.end(), renderer, camera, [&] {
+        // Printed for every frame that culls or draws differently from the one before.
+        if (options.collect_stats) {
+            auto drawn = progressive.GetDrawnTriangleCount();
+            if (progressive.GetCullStats() != cull_stats || drawn != drawn_triangles) {
+                cull_stats = progressive.GetCullStats();
+                drawn_triangles = drawn;
+                gl::PrintCullStats(std::clog, cull_stats);
+                std::clog << std::format("drawn triangles: {}\n", drawn_triangles);
+            }
+        }
+
+        if (finished)
+            return;
+
+        // Read before draining: every batch is queued before the run reports completion.
+        bool done = run.IsDone();
+        for (auto index : run.TakeMarked())
+            progressive.SetTriangleColor(index, scene::INTERSECTED_COLOR);
+        if (!done)
+            return;
+
+        geom.SetResult(run.TakeResult());
+        const auto &colors = geom.GetColors();
+        for (size_t i = 0; i < colors.size(); ++i)
+            progressive.SetTriangleColor(i, colors[i]);
+
+        if (options.collect_stats)
+            intersection::PrintStats(std::clog, geom.GetStats());
+        finished = true;
+    });
+
+    gl::CallProfiler::Get().Dump(std::clog);
 
     return 0;
 } catch (std::exception &ex) {